@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "callback_watchdog.hpp"
+
+#include <rclcpp/logging.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+constexpr std::size_t CallbackWatchdog::NumCallbacks;
+constexpr std::size_t CallbackWatchdog::NumBuckets;
+
+//==============================================================================
+CallbackWatchdog::CallbackWatchdog(rclcpp::Logger logger)
+: _logger(std::move(logger))
+{}
+
+//==============================================================================
+void CallbackWatchdog::set_budget(Callback callback, Duration budget)
+{
+  _channels[static_cast<std::size_t>(callback)].budget = budget;
+}
+
+//==============================================================================
+void CallbackWatchdog::record(
+  Callback callback,
+  const std::string* robot_name,
+  Duration elapsed)
+{
+  auto& channel = _channels[static_cast<std::size_t>(callback)];
+  const int64_t ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+  const auto micros = static_cast<uint64_t>(ns < 0 ? 0 : ns / 1000);
+  channel.buckets[_bucket(micros)].fetch_add(1, std::memory_order_relaxed);
+
+  int64_t max = channel.max.load(std::memory_order_relaxed);
+  while (ns > max && !channel.max.compare_exchange_weak(
+      max, ns, std::memory_order_relaxed))
+  {
+    // Try again with the max that another thread recorded in the meantime
+  }
+
+  if (elapsed <= channel.budget)
+    return;
+
+  channel.over_budget.fetch_add(1, std::memory_order_relaxed);
+  RCLCPP_WARN(
+    _logger,
+    "Slow callback: callback=%s robot=%s duration_ms=%.3f budget_ms=%.3f",
+    name(callback), robot_name ? robot_name->c_str() : "",
+    static_cast<double>(ns) / 1e6,
+    std::chrono::duration<double, std::milli>(channel.budget).count());
+}
+
+//==============================================================================
+auto CallbackWatchdog::collect() -> std::vector<Summary>
+{
+  std::vector<Summary> summaries;
+  for (std::size_t c = 0; c < NumCallbacks; ++c)
+  {
+    auto& channel = _channels[c];
+
+    // Buckets are drained one at a time, so a callback that finishes during
+    // the collection may land in either window, but never in both.
+    std::array<uint64_t, NumBuckets> counts;
+    uint64_t count = 0;
+    for (std::size_t b = 0; b < NumBuckets; ++b)
+    {
+      counts[b] = channel.buckets[b].exchange(0, std::memory_order_relaxed);
+      count += counts[b];
+    }
+
+    const uint64_t over_budget =
+      channel.over_budget.exchange(0, std::memory_order_relaxed);
+    const int64_t max = channel.max.exchange(0, std::memory_order_relaxed);
+    if (count == 0)
+      continue;
+
+    const auto percentile = [&](double p)
+      {
+        const auto target = static_cast<uint64_t>(p * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (std::size_t b = 0; b < NumBuckets; ++b)
+        {
+          seen += counts[b];
+          if (seen >= target)
+          {
+            return std::min<Duration>(
+              std::chrono::microseconds(_bucket_upper_bound(b)),
+              std::chrono::nanoseconds(max));
+          }
+        }
+        return Duration(std::chrono::nanoseconds(max));
+      };
+
+    summaries.push_back(
+      Summary{
+        static_cast<Callback>(c), count, over_budget,
+        percentile(0.5), percentile(0.99), std::chrono::nanoseconds(max)});
+  }
+
+  return summaries;
+}
+
+//==============================================================================
+const char* CallbackWatchdog::name(Callback callback)
+{
+  switch (callback)
+  {
+    case Callback::Ingest:
+      return "ingest";
+    case Callback::Registration:
+      return "registration";
+    case Callback::Registered:
+      return "registered";
+    case Callback::FollowPath:
+      return "follow_new_path";
+    case Callback::Stop:
+      return "stop";
+    case Callback::Dock:
+      return "dock";
+    case Callback::SnapshotService:
+      return "snapshot_service";
+    case Callback::DeltaPublish:
+      return "delta_publish";
+    case Callback::OutboxFlush:
+      return "outbox_flush";
+    case Callback::ShardRefresh:
+      return "shard_refresh";
+    default:
+      return "unknown";
+  }
+}
+
+//==============================================================================
+std::size_t CallbackWatchdog::_bucket(uint64_t micros)
+{
+  if (micros < 4)
+    return static_cast<std::size_t>(micros);
+
+  // The top two bits below the leading one pick the quarter of the octave.
+  const std::size_t octave = 63 - static_cast<std::size_t>(
+    __builtin_clzll(micros));
+  const std::size_t quarter = (micros >> (octave - 2)) & 3;
+  const std::size_t bucket = 4 * (octave - 1) + quarter;
+  return bucket < NumBuckets ? bucket : NumBuckets - 1;
+}
+
+//==============================================================================
+uint64_t CallbackWatchdog::_bucket_upper_bound(std::size_t bucket)
+{
+  if (bucket < 4)
+    return bucket;
+
+  const std::size_t octave = bucket / 4 + 1;
+  const uint64_t width = uint64_t(1) << (octave - 2);
+  return (4 + bucket % 4) * width + width - 1;
+}
+
+} // namespace rmf
+} // namespace free_fleet
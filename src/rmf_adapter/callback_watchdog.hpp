@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__CALLBACK_WATCHDOG_HPP
+#define SRC__RMF_ADAPTER__CALLBACK_WATCHDOG_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <rclcpp/logger.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// The kinds of adapter callbacks that get timed
+enum class Callback : uint8_t
+{
+  /// A drain of the incoming robot states
+  Ingest,
+
+  /// Starting the registration of a robot with the fleet adapter
+  Registration,
+
+  /// The fleet adapter finishing the registration of a robot
+  Registered,
+
+  FollowPath,
+  Stop,
+  Dock,
+
+  /// Answering a request for a page of the fleet snapshot
+  SnapshotService,
+
+  /// Encoding and publishing a fleet state delta
+  DeltaPublish,
+
+  /// Sending the batched robot commands
+  OutboxFlush,
+
+  /// Refreshing the shard membership
+  ShardRefresh,
+
+  Count
+};
+
+//==============================================================================
+/// Times the callbacks of the adapter. Any callback that takes longer than the
+/// budget of its kind is reported right away, and a histogram per kind keeps
+/// the durations between reports. Recording is lock free, so callbacks on
+/// different threads never wait for each other here.
+class CallbackWatchdog
+{
+public:
+
+  using Duration = std::chrono::steady_clock::duration;
+
+  static constexpr std::size_t NumCallbacks =
+    static_cast<std::size_t>(Callback::Count);
+
+  /// Durations of one kind of callback since the last collection
+  struct Summary
+  {
+    Callback callback;
+    uint64_t count;
+    uint64_t over_budget;
+
+    /// Percentiles are accurate to within a quarter of their magnitude
+    Duration p50;
+    Duration p99;
+    Duration max;
+  };
+
+  /// Times a callback from construction until destruction. A null watchdog
+  /// times nothing.
+  class Scope
+  {
+  public:
+
+    Scope(
+      CallbackWatchdog* watchdog,
+      Callback callback,
+      const std::string* robot_name = nullptr)
+    : _watchdog(watchdog),
+      _callback(callback),
+      _robot_name(robot_name)
+    {
+      if (_watchdog)
+        _start = std::chrono::steady_clock::now();
+    }
+
+    ~Scope()
+    {
+      if (_watchdog)
+      {
+        _watchdog->record(
+          _callback, _robot_name, std::chrono::steady_clock::now() - _start);
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    CallbackWatchdog* _watchdog;
+    Callback _callback;
+    const std::string* _robot_name;
+    std::chrono::steady_clock::time_point _start;
+  };
+
+  CallbackWatchdog(rclcpp::Logger logger);
+
+  /// Change the budget of one kind of callback. This is not synchronized with
+  /// recording, so it should be called before any callback runs.
+  void set_budget(Callback callback, Duration budget);
+
+  /// Count a callback that took the given time, and warn if it overran its
+  /// budget
+  void record(
+    Callback callback,
+    const std::string* robot_name,
+    Duration elapsed);
+
+  /// Summarize every kind of callback that ran since the last collection, and
+  /// start over
+  std::vector<Summary> collect();
+
+  static const char* name(Callback callback);
+
+private:
+
+  /// Four buckets per power of two microseconds, up to about a day
+  static constexpr std::size_t NumBuckets = 4 * 36;
+
+  static std::size_t _bucket(uint64_t micros);
+
+  static uint64_t _bucket_upper_bound(std::size_t bucket);
+
+  struct Channel
+  {
+    Duration budget = Duration::max();
+    std::array<std::atomic<uint64_t>, NumBuckets> buckets{};
+    std::atomic<uint64_t> over_budget{0};
+    std::atomic<int64_t> max{0};
+  };
+
+  rclcpp::Logger _logger;
+  std::array<Channel, NumCallbacks> _channels;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__CALLBACK_WATCHDOG_HPP
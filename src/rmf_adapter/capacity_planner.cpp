@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Estimates how many robots one adapter instance can serve on this machine.
+// Synthetic robots on the given navigation graph are driven through the same
+// code the adapter uses: the state table, the state validator, and the robot
+// command handles with real fleet adapter updaters behind them. Robots are
+// localized onto the graph from their synthetic poses, like the adapter does
+// when their first state arrives. The robot count and state rate are swept,
+// and for each combination the busy fraction of one core, the share of ticks
+// that overran their period, the state handling latency and the memory are
+// reported. A combination counts as saturated once the adapter falls behind
+// its ticks or keeps the core nearly always busy.
+//
+// Usage: capacity_planner <nav_graph_file> [--robots N,N,...]
+//                         [--rates HZ,HZ,...] [--duration SECONDS]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmf_traffic/agv/Planner.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+#include <rmf_traffic_ros2/Time.hpp>
+
+#include <rmf_fleet_adapter/agv/Adapter.hpp>
+#include <rmf_fleet_adapter/agv/parse_graph.hpp>
+
+#include "full_control.hpp"
+#include "robot_state_table.hpp"
+#include "state_validator.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Waypoint = rmf_traffic::agv::Plan::Waypoint;
+
+//==============================================================================
+struct Options
+{
+  std::string graph_file;
+  std::vector<std::size_t> robots = {10, 50, 100, 250, 500, 1000};
+  std::vector<double> rates = {1.0, 2.0, 5.0, 10.0};
+  double duration = 5.0;
+};
+
+//==============================================================================
+/// Stands in for the robots. Navigation requests are remembered so that the
+/// synthetic states can acknowledge them and walk along their paths.
+class SyntheticMiddleware : public free_fleet::transport::Middleware
+{
+public:
+
+  struct Robot
+  {
+    std::string task_id;
+    std::vector<free_fleet::messages::Location> path;
+  };
+
+  void send_state(const free_fleet::messages::RobotState&) final {}
+
+  std::vector<free_fleet::messages::RobotState> read_states() final
+  {
+    return {};
+  }
+
+  void send_mode_request(const free_fleet::messages::ModeRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::ModeRequest>
+  read_mode_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_navigation_request(
+    const free_fleet::messages::NavigationRequest& request) final
+  {
+    auto& robot = robots[request.robot_name];
+    robot.task_id = request.task_id;
+    robot.path = request.path;
+  }
+
+  rmf_utils::optional<free_fleet::messages::NavigationRequest>
+  read_navigation_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_relocalization_request(
+    const free_fleet::messages::RelocalizationRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::RelocalizationRequest>
+  read_relocalization_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  std::unordered_map<std::string, Robot> robots;
+};
+
+//==============================================================================
+struct SyntheticRobot
+{
+  std::shared_ptr<free_fleet::rmf::FullControlHandle> handle;
+  std::vector<Waypoint> plan;
+  free_fleet::messages::RobotState state;
+  std::size_t slot;
+  std::atomic<bool> registered{false};
+};
+
+//==============================================================================
+std::vector<std::size_t> parse_sizes(const std::string& list)
+{
+  std::vector<std::size_t> values;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    values.push_back(std::strtoul(item.c_str(), nullptr, 10));
+  return values;
+}
+
+//==============================================================================
+std::vector<double> parse_rates(const std::string& list)
+{
+  std::vector<double> values;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    values.push_back(std::strtod(item.c_str(), nullptr));
+  return values;
+}
+
+//==============================================================================
+bool parse_options(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--robots" && has_value)
+      options.robots = parse_sizes(argv[++i]);
+    else if (arg == "--rates" && has_value)
+      options.rates = parse_rates(argv[++i]);
+    else if (arg == "--duration" && has_value)
+      options.duration = std::strtod(argv[++i], nullptr);
+    else if (options.graph_file.empty() && !arg.empty() && arg[0] != '-')
+      options.graph_file = arg;
+    else
+      return false;
+  }
+
+  std::sort(options.robots.begin(), options.robots.end());
+  return !options.graph_file.empty() && !options.robots.empty()
+    && !options.rates.empty() && options.duration > 0.0;
+}
+
+//==============================================================================
+/// Resident memory of this process in bytes
+std::size_t resident_bytes()
+{
+  std::ifstream statm("/proc/self/statm");
+  std::size_t total = 0;
+  std::size_t resident = 0;
+  statm >> total >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+//==============================================================================
+/// The same traits that the adapter falls back on when no parameters are set
+rmf_traffic::agv::VehicleTraits default_traits()
+{
+  return rmf_traffic::agv::VehicleTraits{
+    {0.7, 0.5},
+    {0.3, 1.5},
+    rmf_traffic::Profile{
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Circle>(0.5),
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Circle>(1.5)
+    }
+  };
+}
+
+//==============================================================================
+/// Advance a synthetic robot by one location along the path it was sent, and
+/// describe where it is now
+void step(
+  SyntheticRobot& robot,
+  SyntheticMiddleware::Robot& commanded)
+{
+  auto& state = robot.state;
+  state.task_id = commanded.task_id;
+  if (!commanded.path.empty())
+  {
+    state.location = commanded.path.front();
+    commanded.path.erase(commanded.path.begin());
+  }
+
+  state.path = commanded.path;
+  state.mode.mode = commanded.path.empty() ?
+    free_fleet::messages::RobotMode::MODE_IDLE :
+    free_fleet::messages::RobotMode::MODE_MOVING;
+}
+
+//==============================================================================
+/// Past either of these the adapter can no longer keep up with its robots
+constexpr double SaturatedBusyFraction = 0.9;
+constexpr double SaturatedOverrunFraction = 0.05;
+
+//==============================================================================
+double percentile(std::vector<int64_t>& samples, double p)
+{
+  if (samples.empty())
+    return 0.0;
+
+  const auto index = static_cast<std::size_t>(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return static_cast<double>(samples[index]) / 1e3;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    std::fprintf(
+      stderr,
+      "Usage: %s <nav_graph_file> [--robots N,N,...] [--rates HZ,HZ,...] "
+      "[--duration SECONDS]\n", argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+  const auto adapter =
+    rmf_fleet_adapter::agv::Adapter::make("capacity_planner");
+  if (!adapter)
+    return 1;
+
+  const std::size_t baseline_memory = resident_bytes();
+
+  const auto traits = std::make_shared<rmf_traffic::agv::VehicleTraits>(
+    default_traits());
+  const auto graph = std::make_shared<rmf_traffic::agv::Graph>(
+    rmf_fleet_adapter::agv::parse_graph(options.graph_file, *traits));
+  if (graph->num_waypoints() < 2)
+  {
+    std::fprintf(stderr, "The graph needs at least two waypoints\n");
+    return 1;
+  }
+
+  const auto fleet = adapter->add_fleet("capacity_planner", *traits, *graph);
+  auto spin = adapter->start();
+
+  const auto middleware = std::make_shared<SyntheticMiddleware>();
+  auto context = std::make_shared<free_fleet::rmf::FleetContext>();
+  context->node = adapter->node().get();
+  context->fleet_name = "capacity_planner";
+  context->graph = graph;
+  context->traits = traits;
+  context->middleware = middleware;
+
+  free_fleet::rmf::RobotStateTable table;
+  table.reserve(options.robots.back());
+  free_fleet::rmf::StateValidator validator(*graph, 10.0);
+
+  rmf_traffic::agv::Planner planner{
+    rmf_traffic::agv::Planner::Configuration{*graph, *traits},
+    rmf_traffic::agv::Planner::Options{nullptr}};
+
+  std::vector<std::unique_ptr<SyntheticRobot>> robots;
+  std::vector<int64_t> localization_samples;
+  std::size_t unlocalized = 0;
+  std::printf(
+    "%8s %8s %10s %10s %10s %10s %8s %10s %10s\n", "robots", "rate_hz",
+    "states", "p50_us", "p99_us", "max_us", "busy_%", "overrun_%", "rss_mb");
+
+  std::size_t saturated_robots = 0;
+  double saturated_rate = 0.0;
+  double states_per_core = 0.0;
+  for (const std::size_t count : options.robots)
+  {
+    // Robots are registered once and reused by every larger robot count.
+    while (robots.size() < count)
+    {
+      const std::size_t n = robots.size();
+      auto robot = std::make_unique<SyntheticRobot>();
+      const std::string name = "synthetic_" + std::to_string(n);
+      robot->handle = std::make_shared<free_fleet::rmf::FullControlHandle>(
+        context, name);
+      robot->slot = table.insert(name).first;
+
+      const std::size_t start = (n * 7919) % graph->num_waypoints();
+      const std::size_t goal = (start + graph->num_waypoints() / 2)
+        % graph->num_waypoints();
+      const auto now = rmf_traffic_ros2::convert(adapter->node()->now());
+      const auto result = planner.plan(
+        rmf_traffic::agv::Plan::Start(now, start, 0.0),
+        rmf_traffic::agv::Planner::Goal(goal));
+      if (result)
+        robot->plan = result->get_waypoints();
+
+      // Robots are placed a little off their waypoint, the way real robots
+      // report themselves, so that localization has something to do.
+      const auto& wp = graph->get_waypoint(start);
+      robot->state.name = name;
+      robot->state.model = "synthetic";
+      robot->state.location.x = wp.get_location()[0] + 0.1;
+      robot->state.location.y = wp.get_location()[1] + 0.1;
+      robot->state.location.level_name = wp.get_map_name();
+
+      const auto& loc = robot->state.location;
+      const auto localize_start = Clock::now();
+      auto starts = rmf_traffic::agv::compute_plan_starts(
+        *graph, loc.level_name, {loc.x, loc.y, loc.yaw}, now);
+      localization_samples.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - localize_start).count());
+
+      // The load should not depend on how well the graph covers the poses.
+      if (starts.empty())
+      {
+        ++unlocalized;
+        starts.emplace_back(now, start, 0.0);
+      }
+
+      auto* raw = robot.get();
+      fleet->add_robot(
+        robot->handle, name, traits->profile(), std::move(starts),
+        [raw](const rmf_fleet_adapter::agv::RobotUpdateHandlePtr& updater)
+        {
+          raw->handle->set_updater(updater);
+          raw->registered = true;
+        });
+      robots.push_back(std::move(robot));
+    }
+
+    const auto registration_deadline = Clock::now() + std::chrono::seconds(60);
+    for (const auto& robot : robots)
+    {
+      while (!robot->registered && Clock::now() < registration_deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (const double rate : options.rates)
+    {
+      const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / rate));
+      const auto tick = std::chrono::milliseconds(100);
+      const auto run_time = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.duration));
+
+      std::vector<free_fleet::messages::RobotState> drain;
+      std::vector<SyntheticRobot*> senders;
+      std::vector<uint8_t> accepted;
+      std::vector<int64_t> samples;
+      std::vector<Clock::time_point> due(count, Clock::now());
+      Clock::duration busy(0);
+      std::size_t ticks = 0;
+      std::size_t overruns = 0;
+
+      const auto begin = Clock::now();
+      auto next_tick = begin;
+      while (Clock::now() - begin < run_time)
+      {
+        const auto tick_start = Clock::now();
+
+        // Robots publish on their own clocks, the adapter drains on its own.
+        drain.clear();
+        senders.clear();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          if (due[i] > tick_start)
+            continue;
+
+          due[i] += period;
+          auto& robot = *robots[i];
+          step(robot, middleware->robots[robot.state.name]);
+          drain.push_back(robot.state);
+          senders.push_back(&robot);
+        }
+
+        validator.validate(drain, accepted);
+        for (std::size_t i = 0; i < drain.size(); ++i)
+        {
+          const auto state_start = Clock::now();
+          const auto& state = drain[i];
+          auto& robot = *senders[i];
+          validator.record(robot.slot, accepted[i]);
+          if (!accepted[i])
+            continue;
+
+          table.update(
+            robot.slot, state, adapter->node()->now().nanoseconds());
+          robot.handle->update_state(state);
+
+          // Robots that have finished their path get it again, so that the
+          // load includes a steady stream of new paths.
+          if (state.path.empty() && !robot.plan.empty())
+            robot.handle->follow_new_path(robot.plan, nullptr, nullptr);
+
+          samples.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+              Clock::now() - state_start).count());
+        }
+
+        const auto now = Clock::now();
+        for (const auto& robot : robots)
+          robot->handle->check_timeouts(now);
+
+        const auto tick_end = Clock::now();
+        busy += tick_end - tick_start;
+        next_tick += tick;
+        ++ticks;
+        if (tick_end > next_tick)
+          ++overruns;
+
+        std::this_thread::sleep_until(next_tick);
+      }
+
+      const double busy_fraction = std::chrono::duration<double>(busy).count()
+        / std::chrono::duration<double>(Clock::now() - begin).count();
+      const double overrun_fraction = ticks == 0 ? 0.0 :
+        static_cast<double>(overruns) / static_cast<double>(ticks);
+      const std::size_t states = samples.size();
+      const double p50 = percentile(samples, 0.5);
+      const double p99 = percentile(samples, 0.99);
+      const double max = percentile(samples, 1.0);
+
+      std::printf(
+        "%8zu %8.1f %10zu %10.1f %10.1f %10.1f %8.1f %10.1f %10.1f\n",
+        count, rate, states, p50, p99, max, 100.0 * busy_fraction,
+        100.0 * overrun_fraction,
+        static_cast<double>(resident_bytes() - baseline_memory) / 1e6);
+
+      if (busy_fraction >= SaturatedBusyFraction
+        || overrun_fraction >= SaturatedOverrunFraction)
+      {
+        if (saturated_robots == 0)
+        {
+          saturated_robots = count;
+          saturated_rate = rate;
+        }
+      }
+      else if (busy_fraction > 0.0)
+      {
+        states_per_core = std::max(
+          states_per_core, count * rate / busy_fraction);
+      }
+    }
+  }
+
+  std::printf(
+    "\nLocalized %zu robots: p50 %.1f us, p99 %.1f us, max %.1f us, %zu "
+    "not on the graph\n", localization_samples.size(),
+    percentile(localization_samples, 0.5),
+    percentile(localization_samples, 0.99),
+    percentile(localization_samples, 1.0), unlocalized);
+
+  std::printf(
+    "Sustainable load: about %.0f robot states per second per core\n",
+    states_per_core);
+  for (const double rate : options.rates)
+  {
+    std::printf(
+      " -- about %.0f robots per core at %.1f Hz\n",
+      states_per_core / rate, rate);
+  }
+
+  if (saturated_robots > 0)
+  {
+    std::printf(
+      "Saturated first at %zu robots publishing at %.1f Hz\n",
+      saturated_robots, saturated_rate);
+  }
+  else
+  {
+    std::printf("No combination saturated one core\n");
+  }
+
+  adapter->stop();
+  spin.wait();
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "command_batch.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+CommandBatchPublisher::CommandBatchPublisher(
+  rclcpp::Node& node,
+  const std::string& topic)
+: _node(node)
+{
+  // Losing a batch would lose the commands of many robots at once.
+  _publisher = _node.create_publisher<free_fleet_ros2::msg::CommandBatch>(
+    topic, rclcpp::QoS(10).reliable());
+  _batch.sequence = 0;
+}
+
+//==============================================================================
+void CommandBatchPublisher::begin_batch()
+{
+  _count = 0;
+}
+
+//==============================================================================
+void CommandBatchPublisher::add(const messages::ModeRequest& request)
+{
+  auto& command = _next_command();
+  command.type = free_fleet_ros2::msg::RobotCommand::TYPE_MODE;
+  command.robot_name = request.robot_name;
+  command.task_id = request.task_id;
+  command.mode = request.mode.mode;
+  command.parameter_names.resize(request.parameters.size());
+  command.parameter_values.resize(request.parameters.size());
+  for (std::size_t i = 0; i < request.parameters.size(); ++i)
+  {
+    command.parameter_names[i] = request.parameters[i].name;
+    command.parameter_values[i] = request.parameters[i].value;
+  }
+  command.path.clear();
+}
+
+//==============================================================================
+void CommandBatchPublisher::add(const messages::NavigationRequest& request)
+{
+  auto& command = _next_command();
+  command.type = free_fleet_ros2::msg::RobotCommand::TYPE_NAVIGATION;
+  command.robot_name = request.robot_name;
+  command.task_id = request.task_id;
+  command.mode = 0;
+  command.parameter_names.clear();
+  command.parameter_values.clear();
+  command.path.resize(request.path.size());
+  for (std::size_t i = 0; i < request.path.size(); ++i)
+  {
+    const auto& from = request.path[i];
+    auto& to = command.path[i];
+    to.t.sec = from.sec;
+    to.t.nanosec = from.nanosec;
+    to.x = from.x;
+    to.y = from.y;
+    to.yaw = from.yaw;
+    to.level_name = from.level_name;
+  }
+}
+
+//==============================================================================
+void CommandBatchPublisher::end_batch()
+{
+  if (_count == 0)
+    return;
+
+  // Entries beyond this batch are set aside rather than destroyed, so that a
+  // larger batch later on can reuse them.
+  auto& commands = _batch.commands;
+  while (commands.size() > _count)
+  {
+    _spare.push_back(std::move(commands.back()));
+    commands.pop_back();
+  }
+
+  ++_batch.sequence;
+  _batch.stamp = _node.now();
+  _publisher->publish(_batch);
+}
+
+//==============================================================================
+free_fleet_ros2::msg::RobotCommand& CommandBatchPublisher::_next_command()
+{
+  auto& commands = _batch.commands;
+  if (_count == commands.size())
+  {
+    if (_spare.empty())
+    {
+      commands.emplace_back();
+    }
+    else
+    {
+      commands.push_back(std::move(_spare.back()));
+      _spare.pop_back();
+    }
+  }
+
+  return _batch.commands[_count++];
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__COMMAND_BATCH_HPP
+#define SRC__RMF_ADAPTER__COMMAND_BATCH_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <free_fleet_ros2/msg/command_batch.hpp>
+
+#include "command_outbox.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Publishes every flush of the command outbox as one CommandBatch sample,
+/// rather than one sample per robot. The message is kept between batches, so
+/// its entries keep their capacity.
+class CommandBatchPublisher : public CommandBatchSink
+{
+public:
+
+  CommandBatchPublisher(rclcpp::Node& node, const std::string& topic);
+
+  void begin_batch() final;
+
+  void add(const messages::ModeRequest& request) final;
+
+  void add(const messages::NavigationRequest& request) final;
+
+  void end_batch() final;
+
+private:
+
+  /// The next entry of the batch, reusing an earlier one where possible
+  free_fleet_ros2::msg::RobotCommand& _next_command();
+
+  rclcpp::Node& _node;
+  rclcpp::Publisher<free_fleet_ros2::msg::CommandBatch>::SharedPtr _publisher;
+  free_fleet_ros2::msg::CommandBatch _batch;
+  std::size_t _count = 0;
+
+  /// Entries of earlier, larger batches that are kept for reuse
+  std::vector<free_fleet_ros2::msg::RobotCommand> _spare;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__COMMAND_BATCH_HPP
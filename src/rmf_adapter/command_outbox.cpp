@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "command_outbox.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+CommandOutbox::CommandOutbox(
+  std::shared_ptr<transport::Middleware> middleware,
+  std::shared_ptr<CommandBatchSink> batch_sink)
+: _middleware(std::move(middleware)),
+  _batch_sink(std::move(batch_sink))
+{}
+
+//==============================================================================
+std::size_t CommandOutbox::add_robot()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.emplace_back();
+  return _entries.size() - 1;
+}
+
+//==============================================================================
+auto CommandOutbox::loan_navigation_request(std::size_t robot)
+-> Loan<messages::NavigationRequest>
+{
+  _mutex.lock();
+  auto& entry = _entries[robot];
+  return Loan<messages::NavigationRequest>(
+    *this, robot, entry.navigation_draft, entry.navigation,
+    entry.navigation_sequence);
+}
+
+//==============================================================================
+auto CommandOutbox::loan_mode_request(std::size_t robot)
+-> Loan<messages::ModeRequest>
+{
+  _mutex.lock();
+  auto& entry = _entries[robot];
+  return Loan<messages::ModeRequest>(
+    *this, robot, entry.mode_draft, entry.mode, entry.mode_sequence);
+}
+
+//==============================================================================
+void CommandOutbox::_queue(std::size_t robot, uint64_t& sequence)
+{
+  const auto& entry = _entries[robot];
+  if (entry.navigation_sequence == 0 && entry.mode_sequence == 0)
+    _queued.push_back(robot);
+
+  sequence = ++_next_sequence;
+}
+
+//==============================================================================
+std::size_t CommandOutbox::flush()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_queued.empty())
+    return 0;
+
+  if (_batch_sink)
+    _batch_sink->begin_batch();
+
+  std::size_t sent = 0;
+  for (const std::size_t robot : _queued)
+  {
+    auto& entry = _entries[robot];
+    const bool mode_first = entry.mode_sequence != 0
+      && (entry.navigation_sequence == 0
+      || entry.mode_sequence < entry.navigation_sequence);
+
+    if (mode_first)
+    {
+      _send(entry.mode);
+      ++sent;
+    }
+
+    if (entry.navigation_sequence != 0)
+    {
+      _send(entry.navigation);
+      ++sent;
+    }
+
+    if (entry.mode_sequence != 0 && !mode_first)
+    {
+      _send(entry.mode);
+      ++sent;
+    }
+
+    entry.navigation_sequence = 0;
+    entry.mode_sequence = 0;
+  }
+
+  if (_batch_sink)
+    _batch_sink->end_batch();
+
+  _queued.clear();
+  ++_flushes;
+  _commands += sent;
+  return sent;
+}
+
+//==============================================================================
+void CommandOutbox::_send(const messages::ModeRequest& request)
+{
+  if (_batch_sink)
+    _batch_sink->add(request);
+  else
+    _middleware->send_mode_request(request);
+}
+
+//==============================================================================
+void CommandOutbox::_send(const messages::NavigationRequest& request)
+{
+  if (_batch_sink)
+    _batch_sink->add(request);
+  else
+    _middleware->send_navigation_request(request);
+}
+
+//==============================================================================
+uint64_t CommandOutbox::flushes() const
+{
+  return _flushes;
+}
+
+//==============================================================================
+uint64_t CommandOutbox::commands() const
+{
+  return _commands;
+}
+
+} // namespace rmf
+} // namespace free_fleet
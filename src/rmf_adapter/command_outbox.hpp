@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__COMMAND_OUTBOX_HPP
+#define SRC__RMF_ADAPTER__COMMAND_OUTBOX_HPP
+
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include <free_fleet/messages/ModeRequest.hpp>
+#include <free_fleet/messages/NavigationRequest.hpp>
+#include <free_fleet/transport/Middleware.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Takes all the commands of one flush at once, so that they can be written
+/// out as a single sample instead of one sample per command
+class CommandBatchSink
+{
+public:
+
+  virtual void begin_batch() = 0;
+
+  virtual void add(const messages::ModeRequest& request) = 0;
+
+  virtual void add(const messages::NavigationRequest& request) = 0;
+
+  virtual void end_batch() = 0;
+
+  virtual ~CommandBatchSink() = default;
+};
+
+//==============================================================================
+/// Collects the commands for the robots of a fleet and writes them out
+/// together, once per tick.
+///
+/// Every robot owns two navigation requests and two mode requests inside the
+/// outbox: the queued one, and a draft that the next command gets built in.
+/// Commands are built by loaning the draft and filling it in place, and
+/// committing swaps it with the queued one. Their strings, paths and
+/// parameters keep their capacity from one command to the next and nothing
+/// gets allocated or copied on the way to the middleware. A command that is
+/// replaced before the next flush is only sent in its latest form. When a
+/// robot has both kinds of commands pending, they get sent in the order they
+/// were committed.
+class CommandOutbox
+{
+public:
+
+  struct Entry;
+
+  /// Exclusive access to the storage of one outgoing request. The outbox
+  /// stays locked for as long as the loan exists, so loans must be short.
+  template<typename Request>
+  class Loan
+  {
+  public:
+
+    /// The draft of the request. It still holds an earlier command of the
+    /// robot, so every field has to be filled in.
+    Request& request()
+    {
+      return *_draft;
+    }
+
+    /// Queue the draft for the next flush in place of whatever was queued
+    /// before. A loan that never gets committed leaves the queued request
+    /// unchanged. Only the first commit of a loan has any effect.
+    void commit();
+
+  private:
+    friend class CommandOutbox;
+
+    Loan(
+      CommandOutbox& outbox,
+      std::size_t robot,
+      Request& draft,
+      Request& queued,
+      uint64_t& sequence);
+
+    std::unique_lock<std::mutex> _lock;
+    CommandOutbox* _outbox;
+    std::size_t _robot;
+    Request* _draft;
+    Request* _queued;
+    uint64_t* _sequence;
+    bool _committed = false;
+  };
+
+  /// Commands get sent through the middleware one by one, unless there is a
+  /// batch sink, which then receives every flush as a whole
+  CommandOutbox(
+    std::shared_ptr<transport::Middleware> middleware,
+    std::shared_ptr<CommandBatchSink> batch_sink = nullptr);
+
+  /// Give a robot its own storage in the outbox. Returns the id that its
+  /// requests are loaned with.
+  std::size_t add_robot();
+
+  Loan<messages::NavigationRequest> loan_navigation_request(std::size_t robot);
+
+  Loan<messages::ModeRequest> loan_mode_request(std::size_t robot);
+
+  /// Write out every queued command. Returns the number of commands sent.
+  std::size_t flush();
+
+  /// Number of flushes that had anything to send
+  uint64_t flushes() const;
+
+  /// Number of commands that have been sent
+  uint64_t commands() const;
+
+private:
+
+  void _queue(std::size_t robot, uint64_t& sequence);
+
+  void _send(const messages::ModeRequest& request);
+
+  void _send(const messages::NavigationRequest& request);
+
+  std::shared_ptr<transport::Middleware> _middleware;
+  std::shared_ptr<CommandBatchSink> _batch_sink;
+
+  std::mutex _mutex;
+  std::vector<Entry> _entries;
+
+  /// Robots with commands waiting for the next flush, in the order that they
+  /// were first queued
+  std::vector<std::size_t> _queued;
+  uint64_t _next_sequence = 0;
+
+  std::atomic<uint64_t> _flushes{0};
+  std::atomic<uint64_t> _commands{0};
+};
+
+//==============================================================================
+struct CommandOutbox::Entry
+{
+  messages::NavigationRequest navigation;
+  messages::ModeRequest mode;
+
+  /// Where the next request of each kind gets built
+  messages::NavigationRequest navigation_draft;
+  messages::ModeRequest mode_draft;
+
+  /// When each request was committed, or zero if it is not queued
+  uint64_t navigation_sequence = 0;
+  uint64_t mode_sequence = 0;
+};
+
+//==============================================================================
+template<typename Request>
+CommandOutbox::Loan<Request>::Loan(
+  CommandOutbox& outbox,
+  std::size_t robot,
+  Request& draft,
+  Request& queued,
+  uint64_t& sequence)
+: _lock(outbox._mutex, std::adopt_lock),
+  _outbox(&outbox),
+  _robot(robot),
+  _draft(&draft),
+  _queued(&queued),
+  _sequence(&sequence)
+{}
+
+//==============================================================================
+template<typename Request>
+void CommandOutbox::Loan<Request>::commit()
+{
+  if (_committed)
+    return;
+
+  // Swapping keeps the capacity of both requests, so the replaced command
+  // becomes the storage of the next draft.
+  using std::swap;
+  swap(*_draft, *_queued);
+  _committed = true;
+  _outbox->_queue(_robot, *_sequence);
+}
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__COMMAND_OUTBOX_HPP
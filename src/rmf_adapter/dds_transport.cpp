@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "dds_transport.hpp"
+
+#include <cstdlib>
+
+#include <rclcpp/logging.hpp>
+
+#include <rmw/rmw.h>
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+const char* const LoopbackConfig =
+  "<CycloneDDS><Domain id=\"any\"><General><Interfaces>"
+  "<NetworkInterface name=\"lo\"/>"
+  "</Interfaces></General></Domain></CycloneDDS>";
+
+//==============================================================================
+const char* const SharedMemoryConfig =
+  "<CycloneDDS><Domain id=\"any\"><SharedMemory>"
+  "<Enable>true</Enable><LogLevel>warn</LogLevel>"
+  "</SharedMemory></Domain></CycloneDDS>";
+
+} // anonymous namespace
+
+//==============================================================================
+rmf_utils::optional<DdsTransport> parse_dds_transport(const std::string& name)
+{
+  if (name.empty() || name == "default" || name == "udp")
+    return DdsTransport::Default;
+
+  if (name == "loopback")
+    return DdsTransport::Loopback;
+
+  if (name == "shm" || name == "shared_memory")
+    return DdsTransport::SharedMemory;
+
+  return rmf_utils::nullopt;
+}
+
+//==============================================================================
+bool dds_transport_applies(
+  const std::string& rmw_identifier,
+  int ros_domain_id,
+  int dds_domain_id)
+{
+  return rmw_identifier.find("cyclonedds") == std::string::npos
+    || ros_domain_id != dds_domain_id;
+}
+
+//==============================================================================
+int ros_domain_id()
+{
+  const char* value = std::getenv("ROS_DOMAIN_ID");
+  if (!value || *value == '\0')
+    return 0;
+
+  return std::atoi(value);
+}
+
+//==============================================================================
+bool configure_dds_transport(
+  DdsTransport transport,
+  int dds_domain_id,
+  rclcpp::Logger logger)
+{
+  const char* fragment = nullptr;
+  if (transport == DdsTransport::Loopback)
+    fragment = LoopbackConfig;
+  else if (transport == DdsTransport::SharedMemory)
+    fragment = SharedMemoryConfig;
+
+  if (!fragment)
+    return true;
+
+  const std::string rmw = rmw_get_implementation_identifier();
+  const int ros_domain = ros_domain_id();
+  if (!dds_transport_applies(rmw, ros_domain, dds_domain_id))
+  {
+    RCLCPP_WARN(
+      logger,
+      "The dds_transport parameter has no effect: the ROS 2 middleware [%s] "
+      "already created DDS domain %d in this process, and the free fleet "
+      "participant shares it. Use a dds_domain other than the ROS domain, or "
+      "set CYCLONEDDS_URI before the adapter starts.",
+      rmw.c_str(), ros_domain);
+    return false;
+  }
+
+  // Cyclone merges every entry of a comma separated CYCLONEDDS_URI, with
+  // later entries taking precedence, so the fragment goes last.
+  std::string uri;
+  if (const char* existing = std::getenv("CYCLONEDDS_URI"))
+  {
+    uri = existing;
+    if (!uri.empty())
+      uri += ",";
+  }
+  uri += fragment;
+
+  if (setenv("CYCLONEDDS_URI", uri.c_str(), 1) != 0)
+  {
+    RCLCPP_ERROR(
+      logger,
+      "Failed to set CYCLONEDDS_URI, the default DDS transport will be used");
+    return false;
+  }
+
+  if (transport == DdsTransport::SharedMemory)
+  {
+    RCLCPP_INFO(
+      logger,
+      "Using the shared memory DDS transport for same-host robots. An iceoryx "
+      "RouDi daemon must be running on this host.");
+  }
+  else
+  {
+    RCLCPP_INFO(logger, "Restricting the DDS transport to loopback");
+  }
+
+  return true;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__DDS_TRANSPORT_HPP
+#define SRC__RMF_ADAPTER__DDS_TRANSPORT_HPP
+
+#include <string>
+
+#include <rmf_utils/optional.hpp>
+
+#include <rclcpp/logger.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// How the free fleet DDS participant exchanges data with the robots
+enum class DdsTransport
+{
+  /// Whatever the Cyclone DDS configuration of the environment says, which is
+  /// UDP on the default interface unless it has been changed
+  Default,
+
+  /// UDP restricted to the loopback interface, for when every robot bridge
+  /// runs on the same host as the adapter
+  Loopback,
+
+  /// Cyclone's shared memory integration. Same-host readers and writers pass
+  /// samples through iceoryx instead of the network stack, while robots on
+  /// other hosts are still reached over UDP. Needs an iceoryx RouDi daemon
+  /// running on the host.
+  SharedMemory
+};
+
+//==============================================================================
+/// Parse the value of the dds_transport parameter: "default", "loopback" or
+/// "shm". Returns nullopt for anything else.
+rmf_utils::optional<DdsTransport> parse_dds_transport(const std::string& name);
+
+//==============================================================================
+/// True if a CYCLONEDDS_URI set now still reaches the free fleet participant.
+/// Cyclone reads its configuration when it creates a domain, and every
+/// participant of a process on the same domain id shares that domain. When
+/// the ROS 2 middleware is Cyclone too, its node has already created the ROS
+/// domain, so a free fleet participant on that same domain id would ignore
+/// the new configuration.
+bool dds_transport_applies(
+  const std::string& rmw_identifier,
+  int ros_domain_id,
+  int dds_domain_id);
+
+//==============================================================================
+/// The domain id of the ROS 2 nodes of this process, from ROS_DOMAIN_ID
+int ros_domain_id();
+
+//==============================================================================
+/// Apply a transport mode to the Cyclone DDS configuration of this process.
+/// This appends a fragment to CYCLONEDDS_URI, so it has to be called before
+/// the free fleet participant gets created. Any configuration the environment
+/// already provides stays in effect. If the configuration could not reach
+/// the participant, see dds_transport_applies(), it is not applied and a
+/// warning is logged instead. Returns true if the transport is in effect.
+bool configure_dds_transport(
+  DdsTransport transport,
+  int dds_domain_id,
+  rclcpp::Logger logger);
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__DDS_TRANSPORT_HPP
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Compares the latency and CPU cost of robot states between two processes on
+// the same host, for each DDS transport the adapter can be configured with.
+// For every transport a server process reads states the way the adapter does,
+// while a client process sends them at a fixed rate the way a robot bridge
+// does. Each process applies the transport before creating its participant.
+//
+// The shared memory transport needs an iceoryx RouDi daemon on this host.
+//
+// Usage: dds_transport_benchmark [--domain D] [--rate HZ] [--messages N]
+//          [transports...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <rclcpp/logging.hpp>
+
+#include <free_fleet_cyclonedds/CycloneDDSMiddleware.hpp>
+
+#include "dds_transport.hpp"
+
+namespace {
+
+using free_fleet::cyclonedds::CycloneDDSMiddleware;
+using free_fleet::rmf::DdsTransport;
+
+const std::string FleetName = "dds_transport_benchmark";
+
+//==============================================================================
+struct Options
+{
+  std::vector<std::string> transports;
+  int domain = 42;
+  double rate = 1000.0;
+  std::size_t messages = 10000;
+};
+
+//==============================================================================
+/// What the server process reports back through its pipe
+struct Latencies
+{
+  std::size_t received = 0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  double max_us = 0.0;
+};
+
+//==============================================================================
+bool parse_options(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--domain" && has_value)
+      options.domain = std::atoi(argv[++i]);
+    else if (arg == "--rate" && has_value)
+      options.rate = std::strtod(argv[++i], nullptr);
+    else if (arg == "--messages" && has_value)
+      options.messages = std::strtoul(argv[++i], nullptr, 10);
+    else if (!arg.empty() && arg[0] != '-')
+      options.transports.push_back(arg);
+    else
+      return false;
+  }
+
+  if (options.transports.empty())
+    options.transports = {"default", "loopback", "shm"};
+
+  for (const auto& name : options.transports)
+  {
+    if (!free_fleet::rmf::parse_dds_transport(name))
+      return false;
+  }
+
+  return options.rate > 0.0 && options.messages > 0;
+}
+
+//==============================================================================
+/// CLOCK_MONOTONIC is shared by every process on the host, so the send time
+/// of a state can be compared against the receive time in another process.
+int64_t now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//==============================================================================
+/// Read states until every message arrived or the sender has been quiet for
+/// a while, and write the latencies to the pipe
+int run_server(const Options& options, DdsTransport transport, int out)
+{
+  free_fleet::rmf::configure_dds_transport(
+    transport, options.domain, rclcpp::get_logger(FleetName));
+  const auto server =
+    CycloneDDSMiddleware::make_server(options.domain, FleetName);
+  if (!server)
+    return 1;
+
+  std::vector<double> latencies;
+  latencies.reserve(options.messages);
+  auto last_received = std::chrono::steady_clock::now();
+  const auto quiet = std::chrono::seconds(5);
+  while (latencies.size() < options.messages
+    && std::chrono::steady_clock::now() - last_received < quiet)
+  {
+    const auto states = server->read_states();
+    const int64_t received = now_ns();
+    for (const auto& state : states)
+    {
+      const int64_t sent = std::strtoll(state.task_id.c_str(), nullptr, 10);
+      latencies.push_back(static_cast<double>(received - sent) / 1000.0);
+    }
+
+    if (!states.empty())
+      last_received = std::chrono::steady_clock::now();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  Latencies result;
+  result.received = latencies.size();
+  if (!latencies.empty())
+  {
+    std::sort(latencies.begin(), latencies.end());
+    const auto at = [&](double q)
+      {
+        return latencies[static_cast<std::size_t>(
+          q * static_cast<double>(latencies.size() - 1))];
+      };
+    result.p50_us = at(0.5);
+    result.p99_us = at(0.99);
+    result.max_us = latencies.back();
+  }
+
+  return write(out, &result, sizeof(result)) == sizeof(result) ? 0 : 1;
+}
+
+//==============================================================================
+/// Send one state per period, stamped with its send time
+int run_client(const Options& options, DdsTransport transport)
+{
+  free_fleet::rmf::configure_dds_transport(
+    transport, options.domain, rclcpp::get_logger(FleetName));
+  const auto client =
+    CycloneDDSMiddleware::make_client(options.domain, FleetName);
+  if (!client)
+    return 1;
+
+  // Give discovery time to match the two participants
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+
+  free_fleet::messages::RobotState state{};
+  state.name = "robot";
+  state.model = "benchmark";
+  state.battery_percent = 100.0;
+  state.mode.mode = free_fleet::messages::RobotMode::MODE_MOVING;
+
+  const auto period = std::chrono::duration_cast<
+    std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / options.rate));
+  auto next = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < options.messages; ++i)
+  {
+    std::this_thread::sleep_until(next);
+    next += period;
+
+    state.location.x = static_cast<double>(i);
+    state.task_id = std::to_string(now_ns());
+    client->send_state(state);
+  }
+
+  return 0;
+}
+
+//==============================================================================
+double cpu_ms(const rusage& usage)
+{
+  const auto ms = [](const timeval& t)
+    {
+      return static_cast<double>(t.tv_sec) * 1e3
+        + static_cast<double>(t.tv_usec) / 1e3;
+    };
+  return ms(usage.ru_utime) + ms(usage.ru_stime);
+}
+
+//==============================================================================
+/// Fork a process that runs the given function and exits with its result
+template<typename Run>
+pid_t spawn(Run run)
+{
+  const pid_t pid = fork();
+  if (pid == 0)
+    _exit(run());
+
+  return pid;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    std::fprintf(
+      stderr,
+      "Usage: %s [--domain D] [--rate HZ] [--messages N] "
+      "[default|loopback|shm...]\n", argv[0]);
+    return 1;
+  }
+
+  std::printf(
+    "%10s %10s %10s %10s %10s %14s %14s\n",
+    "transport", "received", "p50 us", "p99 us", "max us",
+    "server us/msg", "client us/msg");
+
+  for (const auto& name : options.transports)
+  {
+    const DdsTransport transport = *free_fleet::rmf::parse_dds_transport(name);
+
+    int fds[2];
+    if (pipe(fds) != 0)
+      return 1;
+
+    const pid_t server = spawn(
+      [&]()
+      {
+        close(fds[0]);
+        return run_server(options, transport, fds[1]);
+      });
+    close(fds[1]);
+
+    const pid_t client = spawn(
+      [&]() { return run_client(options, transport); });
+
+    Latencies result;
+    const bool read_ok =
+      read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int server_status = 0;
+    int client_status = 0;
+    rusage server_usage{};
+    rusage client_usage{};
+    wait4(server, &server_status, 0, &server_usage);
+    wait4(client, &client_status, 0, &client_usage);
+
+    if (!read_ok || server_status != 0 || client_status != 0)
+    {
+      std::printf("%10s %10s\n", name.c_str(), "failed");
+      continue;
+    }
+
+    const double messages = static_cast<double>(options.messages);
+    std::printf(
+      "%10s %10zu %10.1f %10.1f %10.1f %14.2f %14.2f\n",
+      name.c_str(), result.received, result.p50_us, result.p99_us,
+      result.max_us, cpu_ms(server_usage) * 1e3 / messages,
+      cpu_ms(client_usage) * 1e3 / messages);
+  }
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_fleet_adapter/StandardNames.hpp>
+
+#include "facility_requests.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+
+//==============================================================================
+/// Picks out the events of a plan that involve infrastructure which takes a
+/// while to get ready. Everything that happens once the robot is inside a lift
+/// is left to the fleet adapter.
+class FacilityCollector : public rmf_traffic::agv::Graph::Lane::Executor
+{
+public:
+
+  using Lane = rmf_traffic::agv::Graph::Lane;
+
+  FacilityCollector(std::vector<FacilityEvent>& events)
+  : _events(events)
+  {}
+
+  std::size_t plan_index = 0;
+  rmf_traffic::Time arrival;
+
+  void execute(const Lane::DoorOpen& open) final
+  {
+    _events.push_back(
+      FacilityEvent{
+        FacilityEvent::Kind::Door, plan_index, arrival, open.name(), ""});
+  }
+
+  void execute(const Lane::LiftSessionBegin& begin) final
+  {
+    _events.push_back(
+      FacilityEvent{
+        FacilityEvent::Kind::Lift, plan_index, arrival, begin.lift_name(),
+        begin.floor_name()});
+  }
+
+  void execute(const Lane::DoorClose&) final {}
+  void execute(const Lane::LiftDoorOpen&) final {}
+  void execute(const Lane::LiftSessionEnd&) final {}
+  void execute(const Lane::LiftMove&) final {}
+  void execute(const Lane::Wait&) final {}
+  void execute(const Lane::Dock&) final {}
+
+private:
+  std::vector<FacilityEvent>& _events;
+};
+
+} // anonymous namespace
+
+//==============================================================================
+bool FacilityEvent::same_request(const FacilityEvent& other) const
+{
+  return kind == other.kind && name == other.name && floor == other.floor;
+}
+
+//==============================================================================
+void find_facility_events(
+  const rmf_traffic::agv::Plan::Waypoint* waypoints,
+  std::size_t count,
+  std::vector<FacilityEvent>& events)
+{
+  FacilityCollector collector(events);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const auto* event = waypoints[i].event();
+    if (!event)
+      continue;
+
+    collector.plan_index = i;
+    collector.arrival = waypoints[i].time();
+    event->execute(collector);
+  }
+}
+
+//==============================================================================
+void FacilityLookahead::hand_over()
+{
+  _events.clear();
+}
+
+//==============================================================================
+std::vector<FacilityEvent>& FacilityLookahead::events()
+{
+  return _events;
+}
+
+//==============================================================================
+FacilityRequester::FacilityRequester(
+  rclcpp::Node& node,
+  rmf_traffic::Duration lead_time)
+: _node(node),
+  _lead_time(lead_time)
+{
+  _door_publisher = _node.create_publisher<rmf_door_msgs::msg::DoorRequest>(
+    rmf_fleet_adapter::AdapterDoorRequestTopicName,
+    rclcpp::SystemDefaultsQoS());
+
+  _lift_publisher = _node.create_publisher<rmf_lift_msgs::msg::LiftRequest>(
+    rmf_fleet_adapter::AdapterLiftRequestTopicName,
+    rclcpp::SystemDefaultsQoS());
+}
+
+//==============================================================================
+rmf_traffic::Duration FacilityRequester::lead_time() const
+{
+  return _lead_time;
+}
+
+//==============================================================================
+void FacilityRequester::request(
+  const FacilityEvent& event,
+  const std::string& requester_id)
+{
+  if (event.kind == FacilityEvent::Kind::Door)
+  {
+    _publish_door(
+      event.name, requester_id, rmf_door_msgs::msg::DoorMode::MODE_OPEN);
+  }
+  else
+  {
+    _publish_lift(
+      event, requester_id, rmf_lift_msgs::msg::LiftRequest::REQUEST_AGV_MODE);
+  }
+}
+
+//==============================================================================
+void FacilityRequester::release(
+  const FacilityEvent& event,
+  const std::string& requester_id)
+{
+  if (event.kind == FacilityEvent::Kind::Door)
+  {
+    _publish_door(
+      event.name, requester_id, rmf_door_msgs::msg::DoorMode::MODE_CLOSED);
+  }
+  else
+  {
+    _publish_lift(
+      event, requester_id,
+      rmf_lift_msgs::msg::LiftRequest::REQUEST_END_SESSION);
+  }
+}
+
+//==============================================================================
+void FacilityRequester::_publish_door(
+  const std::string& door,
+  const std::string& requester_id,
+  uint32_t mode)
+{
+  rmf_door_msgs::msg::DoorRequest msg;
+  msg.request_time = _node.now();
+  msg.requester_id = requester_id;
+  msg.door_name = door;
+  msg.requested_mode.value = mode;
+  _door_publisher->publish(msg);
+}
+
+//==============================================================================
+void FacilityRequester::_publish_lift(
+  const FacilityEvent& event,
+  const std::string& requester_id,
+  uint8_t request_type)
+{
+  rmf_lift_msgs::msg::LiftRequest msg;
+  msg.lift_name = event.name;
+  msg.request_time = _node.now();
+  msg.session_id = requester_id;
+  msg.request_type = request_type;
+  msg.destination_floor = event.floor;
+  msg.door_state = rmf_lift_msgs::msg::LiftRequest::DOOR_OPEN;
+  _lift_publisher->publish(msg);
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__FACILITY_REQUESTS_HPP
+#define SRC__RMF_ADAPTER__FACILITY_REQUESTS_HPP
+
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmf_door_msgs/msg/door_request.hpp>
+#include <rmf_lift_msgs/msg/lift_request.hpp>
+
+#include <rmf_traffic/agv/Planner.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// A door or lift that a path needs, which can be asked for before the robot
+/// gets there
+struct FacilityEvent
+{
+  enum class Kind : uint8_t
+  {
+    Door,
+    Lift
+  };
+
+  Kind kind;
+
+  /// Index of the waypoint in the plan where the robot needs the facility
+  std::size_t plan_index;
+
+  /// When the plan has the robot arrive at that waypoint
+  rmf_traffic::Time arrival;
+
+  /// Name of the door or lift
+  std::string name;
+
+  /// Floor that the lift gets called to. This is empty for doors.
+  std::string floor;
+
+  /// Whether a request has been sent for this event
+  bool requested = false;
+
+  /// True if both events ask for the same thing, whatever their position in
+  /// the plan
+  bool same_request(const FacilityEvent& other) const;
+};
+
+//==============================================================================
+/// Append the doors that a path opens and the lifts that it calls, in the
+/// order that the robot gets to them
+void find_facility_events(
+  const rmf_traffic::agv::Plan::Waypoint* waypoints,
+  std::size_t count,
+  std::vector<FacilityEvent>& events);
+
+//==============================================================================
+/// The doors and lifts of one robot's current path, and which of them have
+/// been requested already. All times must be on the clock that plans are
+/// scheduled against.
+class FacilityLookahead
+{
+public:
+
+  /// Switch to the events of a new path. Requests of the old path that the
+  /// new one still needs are carried over, so that a replan does not close a
+  /// door in front of the robot. The others are passed to release.
+  template<typename ReleaseFn>
+  void replan(
+    const rmf_traffic::agv::Plan::Waypoint* waypoints,
+    std::size_t count,
+    ReleaseFn&& release);
+
+  /// Forget the events before next_plan_index, which the robot has reached
+  /// and the fleet adapter takes care of. Then pass every event that the
+  /// robot reaches within the lead time to request, assuming that it keeps
+  /// running late by delay.
+  template<typename RequestFn>
+  void update(
+    std::size_t next_plan_index,
+    rmf_traffic::Duration delay,
+    rmf_traffic::Time now,
+    rmf_traffic::Duration lead_time,
+    RequestFn&& request);
+
+  /// Pass every requested event to release and forget all events, for when
+  /// the robot will not reach them after all
+  template<typename ReleaseFn>
+  void release_all(ReleaseFn&& release);
+
+  /// Forget every event without releasing it, once the fleet adapter has
+  /// taken over
+  void hand_over();
+
+  std::vector<FacilityEvent>& events();
+
+private:
+  std::vector<FacilityEvent> _events;
+
+  /// Scratch space for the events of the next path
+  std::vector<FacilityEvent> _next;
+};
+
+//==============================================================================
+/// Sends door and lift requests on behalf of the robots of a fleet, ahead of
+/// the requests that the fleet adapter makes once a robot has arrived.
+///
+/// The requests use the same requester and session ids as the fleet adapter,
+/// so the door and lift supervisors treat them as one and the same. Once the
+/// robot arrives, the fleet adapter takes over and also releases the facility
+/// after the robot is through. Only requests for facilities that the robot
+/// never got to have to be released here.
+class FacilityRequester
+{
+public:
+
+  /// lead_time is how long before the estimated arrival of a robot its
+  /// requests get sent
+  FacilityRequester(rclcpp::Node& node, rmf_traffic::Duration lead_time);
+
+  rmf_traffic::Duration lead_time() const;
+
+  /// Ask for a door to be opened, or for a lift to come to a floor
+  void request(const FacilityEvent& event, const std::string& requester_id);
+
+  /// Withdraw a request that is no longer needed
+  void release(const FacilityEvent& event, const std::string& requester_id);
+
+private:
+
+  void _publish_door(
+    const std::string& door,
+    const std::string& requester_id,
+    uint32_t mode);
+
+  void _publish_lift(
+    const FacilityEvent& event,
+    const std::string& requester_id,
+    uint8_t request_type);
+
+  rclcpp::Node& _node;
+
+  rmf_traffic::Duration _lead_time;
+
+  rclcpp::Publisher<rmf_door_msgs::msg::DoorRequest>::SharedPtr
+    _door_publisher;
+
+  rclcpp::Publisher<rmf_lift_msgs::msg::LiftRequest>::SharedPtr
+    _lift_publisher;
+};
+
+//==============================================================================
+template<typename ReleaseFn>
+void FacilityLookahead::replan(
+  const rmf_traffic::agv::Plan::Waypoint* waypoints,
+  std::size_t count,
+  ReleaseFn&& release)
+{
+  _next.clear();
+  find_facility_events(waypoints, count, _next);
+
+  for (const auto& event : _events)
+  {
+    if (!event.requested)
+      continue;
+
+    const auto match = std::find_if(_next.begin(), _next.end(),
+        [&event](const FacilityEvent& next)
+        {
+          return !next.requested && next.same_request(event);
+        });
+
+    if (match != _next.end())
+      match->requested = true;
+    else
+      release(event);
+  }
+
+  std::swap(_events, _next);
+}
+
+//==============================================================================
+template<typename RequestFn>
+void FacilityLookahead::update(
+  std::size_t next_plan_index,
+  rmf_traffic::Duration delay,
+  rmf_traffic::Time now,
+  rmf_traffic::Duration lead_time,
+  RequestFn&& request)
+{
+  auto first = _events.begin();
+  while (first != _events.end() && first->plan_index < next_plan_index)
+    ++first;
+  _events.erase(_events.begin(), first);
+
+  for (auto& event : _events)
+  {
+    if (event.requested)
+      continue;
+
+    // Events are in the order that the robot gets to them.
+    if (event.arrival + delay - now > lead_time)
+      break;
+
+    request(event);
+    event.requested = true;
+  }
+}
+
+//==============================================================================
+template<typename ReleaseFn>
+void FacilityLookahead::release_all(ReleaseFn&& release)
+{
+  for (const auto& event : _events)
+  {
+    if (event.requested)
+      release(event);
+  }
+
+  _events.clear();
+}
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__FACILITY_REQUESTS_HPP
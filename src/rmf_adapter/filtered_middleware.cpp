@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include "filtered_middleware.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+bool StateFilter::accepts(const messages::RobotState& state) const
+{
+  if (!robot_names.empty() && robot_names.count(state.name) == 0)
+    return false;
+
+  if (!levels.empty() && levels.count(state.location.level_name) == 0)
+    return false;
+
+  return !predicate || predicate(state);
+}
+
+//==============================================================================
+FilteredMiddleware::FilteredMiddleware(
+  std::shared_ptr<transport::Middleware> middleware,
+  StateFilter filter)
+: _middleware(std::move(middleware)),
+  _filter(std::move(filter))
+{}
+
+//==============================================================================
+void FilteredMiddleware::send_state(const messages::RobotState& state)
+{
+  _middleware->send_state(state);
+}
+
+//==============================================================================
+std::vector<messages::RobotState> FilteredMiddleware::read_states()
+{
+  auto states = _middleware->read_states();
+  const auto end = std::remove_if(states.begin(), states.end(),
+      [this](const messages::RobotState& state)
+      {
+        return !_filter.accepts(state);
+      });
+
+  _discarded += static_cast<uint64_t>(states.end() - end);
+  states.erase(end, states.end());
+
+  if (_filter.history_depth == 0 || states.size() <= _filter.history_depth)
+    return states;
+
+  // Walk from the newest state backwards so that the states which get kept
+  // are the latest ones of each robot, then compact while keeping the order
+  // in which they arrived.
+  _history.clear();
+  std::vector<bool> keep(states.size());
+  for (std::size_t i = states.size(); i-- > 0; )
+    keep[i] = ++_history[states[i].name] <= _filter.history_depth;
+
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < states.size(); ++i)
+  {
+    if (!keep[i])
+      continue;
+
+    if (kept != i)
+      states[kept] = std::move(states[i]);
+    ++kept;
+  }
+
+  _superseded += static_cast<uint64_t>(states.size() - kept);
+  states.resize(kept);
+  return states;
+}
+
+//==============================================================================
+void FilteredMiddleware::send_mode_request(
+  const messages::ModeRequest& request)
+{
+  _middleware->send_mode_request(request);
+}
+
+//==============================================================================
+rmf_utils::optional<messages::ModeRequest>
+FilteredMiddleware::read_mode_request()
+{
+  return _middleware->read_mode_request();
+}
+
+//==============================================================================
+void FilteredMiddleware::send_navigation_request(
+  const messages::NavigationRequest& request)
+{
+  _middleware->send_navigation_request(request);
+}
+
+//==============================================================================
+rmf_utils::optional<messages::NavigationRequest>
+FilteredMiddleware::read_navigation_request()
+{
+  return _middleware->read_navigation_request();
+}
+
+//==============================================================================
+void FilteredMiddleware::send_relocalization_request(
+  const messages::RelocalizationRequest& request)
+{
+  _middleware->send_relocalization_request(request);
+}
+
+//==============================================================================
+rmf_utils::optional<messages::RelocalizationRequest>
+FilteredMiddleware::read_relocalization_request()
+{
+  return _middleware->read_relocalization_request();
+}
+
+//==============================================================================
+uint64_t FilteredMiddleware::discarded() const
+{
+  return _discarded;
+}
+
+//==============================================================================
+uint64_t FilteredMiddleware::superseded() const
+{
+  return _superseded;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__FILTERED_MIDDLEWARE_HPP
+#define SRC__RMF_ADAPTER__FILTERED_MIDDLEWARE_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <free_fleet/transport/Middleware.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Which robot states a server should accept. An empty set accepts every
+/// value of its field.
+struct StateFilter
+{
+  std::unordered_set<std::string> robot_names;
+
+  std::unordered_set<std::string> levels;
+
+  /// Additional check that every state has to pass, if set
+  std::function<bool(const messages::RobotState&)> predicate;
+
+  /// How many of the newest states of each robot to keep from a single read,
+  /// like a keep-last history. Older states of the same robot are obsolete by
+  /// the time they are processed. Zero keeps every state.
+  std::size_t history_depth = 0;
+
+  bool accepts(const messages::RobotState& state) const;
+};
+
+//==============================================================================
+/// Wraps a free fleet middleware so that states which do not match a filter,
+/// or which have been superseded by newer states of the same robot, are
+/// discarded as they are read, before anything else in the adapter sees them.
+/// Every other call is passed through unchanged.
+///
+/// States are already separated by fleet, because the middleware uses a
+/// separate set of topics for each fleet name.
+class FilteredMiddleware : public transport::Middleware
+{
+public:
+
+  FilteredMiddleware(
+    std::shared_ptr<transport::Middleware> middleware,
+    StateFilter filter);
+
+  void send_state(const messages::RobotState& state) final;
+
+  std::vector<messages::RobotState> read_states() final;
+
+  void send_mode_request(const messages::ModeRequest& request) final;
+
+  rmf_utils::optional<messages::ModeRequest> read_mode_request() final;
+
+  void send_navigation_request(
+    const messages::NavigationRequest& request) final;
+
+  rmf_utils::optional<messages::NavigationRequest>
+  read_navigation_request() final;
+
+  void send_relocalization_request(
+    const messages::RelocalizationRequest& request) final;
+
+  rmf_utils::optional<messages::RelocalizationRequest>
+  read_relocalization_request() final;
+
+  /// Number of states that have been discarded by the filter
+  uint64_t discarded() const;
+
+  /// Number of states that were dropped because newer states of the same
+  /// robot arrived in the same read
+  uint64_t superseded() const;
+
+private:
+  std::shared_ptr<transport::Middleware> _middleware;
+  StateFilter _filter;
+  std::atomic<uint64_t> _discarded{0};
+  std::atomic<uint64_t> _superseded{0};
+
+  /// Scratch space for counting the states of each robot within a read
+  std::unordered_map<std::string, std::size_t> _history;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__FILTERED_MIDDLEWARE_HPP
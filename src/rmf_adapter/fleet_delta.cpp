@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+
+#include "fleet_delta.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+double angle_difference(double a, double b)
+{
+  return std::abs(std::remainder(a - b, 2.0 * M_PI));
+}
+
+} // anonymous namespace
+
+//==============================================================================
+FleetDeltaEncoder::FleetDeltaEncoder(
+  DeltaThresholds thresholds,
+  int64_t keyframe_period)
+: _thresholds(thresholds),
+  _keyframe_period(keyframe_period)
+{}
+
+//==============================================================================
+bool FleetDeltaEncoder::encode(
+  const FleetSnapshot& snapshot,
+  int64_t now_ns,
+  Frame& frame)
+{
+  const bool keyframe = _last_keyframe == INT64_MIN
+    || now_ns - _last_keyframe >= _keyframe_period;
+
+  // Nothing can have changed if no new snapshot was published.
+  if (!keyframe && snapshot.version() == _last_version)
+    return false;
+
+  _last_version = snapshot.version();
+  frame.robots.clear();
+  for (const auto& level : snapshot.levels())
+  {
+    // A level that is shared with the last snapshot that was encoded has
+    // not changed since then, so none of its robots can have either.
+    auto& encoded = _encoded[level->name];
+    if (!keyframe && encoded == level)
+      continue;
+
+    encoded = level;
+    for (const auto& robot : level->robots)
+    {
+      auto sent = _sent.find(robot->name);
+      if (sent == _sent.end())
+        sent = _sent.insert({robot->name, Sent()}).first;
+      else if (!keyframe && !_changed(sent->second, *robot))
+        continue;
+
+      // Only what was actually sent becomes the reference, so slow drift
+      // still adds up to a delta eventually.
+      auto& s = sent->second;
+      s.x = robot->x;
+      s.y = robot->y;
+      s.yaw = robot->yaw;
+      s.mode = robot->mode;
+      s.level_name = robot->level_name;
+      s.task_id = robot->task_id;
+      frame.robots.push_back(robot.get());
+    }
+  }
+
+  if (!keyframe && frame.robots.empty())
+    return false;
+
+  frame.sequence = ++_sequence;
+  frame.keyframe = keyframe;
+  frame.stamp = now_ns;
+  if (keyframe)
+  {
+    _keyframe_sequence = frame.sequence;
+    _last_keyframe = now_ns;
+  }
+  frame.keyframe_sequence = _keyframe_sequence;
+  return true;
+}
+
+//==============================================================================
+bool FleetDeltaEncoder::_changed(
+  const Sent& sent,
+  const RobotSnapshot& robot) const
+{
+  const double dx = robot.x - sent.x;
+  const double dy = robot.y - sent.y;
+  const double p = _thresholds.position;
+  return dx * dx + dy * dy > p * p
+    || angle_difference(robot.yaw, sent.yaw) > _thresholds.yaw
+    || robot.mode != sent.mode
+    || robot.level_name != sent.level_name
+    || robot.task_id != sent.task_id;
+}
+
+} // namespace rmf
+} // namespace free_fleet
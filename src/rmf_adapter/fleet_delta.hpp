@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__FLEET_DELTA_HPP
+#define SRC__RMF_ADAPTER__FLEET_DELTA_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "fleet_snapshot.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// How far a robot has to move before it is included in a delta
+struct DeltaThresholds
+{
+  /// Distance in meters
+  double position = 0.05;
+
+  /// Rotation in radians
+  double yaw = 0.05;
+};
+
+//==============================================================================
+/// Turns the fleet snapshots into a stream of frames for UIs: a keyframe with
+/// every robot every so often, and in between only the robots whose view has
+/// changed noticeably. The size of a delta follows how much the fleet moves
+/// rather than how large it is.
+class FleetDeltaEncoder
+{
+public:
+
+  struct Frame
+  {
+    uint64_t sequence = 0;
+    bool keyframe = false;
+    uint64_t keyframe_sequence = 0;
+    int64_t stamp = 0;
+    std::vector<const RobotSnapshot*> robots;
+  };
+
+  /// keyframe_period is in nanoseconds of adapter time
+  FleetDeltaEncoder(DeltaThresholds thresholds, int64_t keyframe_period);
+
+  /// Work out the next frame from a snapshot, at the given adapter time in
+  /// nanoseconds. Returns false if there is nothing worth sending. The robot
+  /// pointers in the frame point into the snapshot.
+  bool encode(const FleetSnapshot& snapshot, int64_t now_ns, Frame& frame);
+
+private:
+
+  struct Sent
+  {
+    double x;
+    double y;
+    double yaw;
+    uint32_t mode;
+    std::string level_name;
+    std::string task_id;
+  };
+
+  bool _changed(const Sent& sent, const RobotSnapshot& robot) const;
+
+  DeltaThresholds _thresholds;
+  int64_t _keyframe_period;
+  uint64_t _sequence = 0;
+  uint64_t _keyframe_sequence = 0;
+  int64_t _last_keyframe = INT64_MIN;
+  uint64_t _last_version = 0;
+  std::unordered_map<std::string, Sent> _sent;
+
+  /// The level of each name in the last snapshot that was encoded
+  std::unordered_map<std::string, FleetSnapshot::LevelPtr> _encoded;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__FLEET_DELTA_HPP
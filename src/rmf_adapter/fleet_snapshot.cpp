@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <atomic>
+#include <algorithm>
+
+#include "fleet_snapshot.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+uint64_t FleetSnapshot::version() const
+{
+  return _version;
+}
+
+//==============================================================================
+int64_t FleetSnapshot::stamp() const
+{
+  return _stamp;
+}
+
+//==============================================================================
+auto FleetSnapshot::levels() const -> const std::vector<LevelPtr>&
+{
+  return _levels;
+}
+
+//==============================================================================
+std::size_t FleetSnapshot::size() const
+{
+  return _size;
+}
+
+//==============================================================================
+auto FleetSnapshot::page(
+  const std::string& level_name,
+  std::size_t offset,
+  std::size_t limit) const -> Page
+{
+  Page page;
+  auto first = _levels.begin();
+  auto last = _levels.end();
+  if (level_name.empty())
+  {
+    page.total = _size;
+  }
+  else
+  {
+    first = std::lower_bound(_levels.begin(), _levels.end(), level_name,
+        [](const LevelPtr& level, const std::string& name)
+        {
+          return level->name < name;
+        });
+
+    if (first == _levels.end() || (*first)->name != level_name)
+      return page;
+
+    last = first + 1;
+    page.total = (*first)->robots.size();
+  }
+
+  const std::size_t count = offset >= page.total ? 0 :
+    limit == 0 ? page.total - offset : std::min(limit, page.total - offset);
+  page.robots.reserve(count);
+  for (auto level = first; level != last && page.robots.size() < count;
+    ++level)
+  {
+    const auto& robots = (*level)->robots;
+    if (offset >= robots.size())
+    {
+      offset -= robots.size();
+      continue;
+    }
+
+    for (std::size_t i = offset;
+      i < robots.size() && page.robots.size() < count; ++i)
+      page.robots.push_back(robots[i].get());
+
+    offset = 0;
+  }
+
+  return page;
+}
+
+//==============================================================================
+FleetSnapshotPublisher::FleetSnapshotPublisher()
+: _latest(std::make_shared<const FleetSnapshot>())
+{}
+
+//==============================================================================
+void FleetSnapshotPublisher::update(
+  std::size_t slot,
+  const messages::RobotState& state)
+{
+  if (slot >= _working.size())
+  {
+    _working.resize(slot + 1);
+    _updated.resize(slot + 1, false);
+    _published.resize(slot + 1);
+  }
+
+  auto& robot = _working[slot];
+  if (robot.name.empty())
+    robot.name = state.name;
+
+  robot.model = state.model;
+  robot.task_id = state.task_id;
+  robot.battery_percent = state.battery_percent;
+
+  if (!_updated[slot])
+  {
+    _updated[slot] = true;
+    _updated_slots.push_back(slot);
+  }
+}
+
+//==============================================================================
+void FleetSnapshotPublisher::publish(
+  const RobotStateTable& table,
+  int64_t now_ns)
+{
+  if (_updated_slots.empty())
+    return;
+
+  // Levels that robots arrived on or left, which are the only ones that need
+  // to be rebuilt
+  std::vector<std::string> touched;
+  const auto touch = [&touched](const std::string& level_name)
+    {
+      if (std::find(touched.begin(), touched.end(), level_name)
+        == touched.end())
+        touched.push_back(level_name);
+    };
+
+  for (const std::size_t slot : _updated_slots)
+  {
+    _updated[slot] = false;
+    const auto& cold = _working[slot];
+    auto robot = std::make_shared<RobotSnapshot>();
+    robot->name = cold.name;
+    robot->model = cold.model;
+    robot->level_name = table.level_name(table.level[slot]);
+    robot->x = table.x[slot];
+    robot->y = table.y[slot];
+    robot->yaw = table.yaw[slot];
+    robot->mode = table.mode[slot];
+    robot->task_id = cold.task_id;
+    robot->battery_percent = cold.battery_percent;
+    robot->last_seen = table.last_seen[slot];
+
+    const auto& previous = _published[slot];
+    if (!previous || previous->level_name != robot->level_name)
+    {
+      if (previous)
+      {
+        auto& slots = _level_slots[previous->level_name];
+        slots.erase(std::find(slots.begin(), slots.end(), slot));
+        touch(previous->level_name);
+      }
+
+      auto& slots = _level_slots[robot->level_name];
+      slots.insert(std::upper_bound(slots.begin(), slots.end(), slot), slot);
+    }
+
+    touch(robot->level_name);
+    _published[slot] = std::move(robot);
+  }
+
+  _updated_slots.clear();
+  for (const auto& level_name : touched)
+    _rebuild_level(level_name);
+
+  auto snapshot = std::make_shared<FleetSnapshot>();
+  snapshot->_version = ++_version;
+  snapshot->_stamp = now_ns;
+  snapshot->_levels.reserve(_levels.size());
+  for (const auto& level : _levels)
+  {
+    snapshot->_size += level.second->robots.size();
+    snapshot->_levels.push_back(level.second);
+  }
+
+  std::atomic_store(
+    &_latest, std::shared_ptr<const FleetSnapshot>(std::move(snapshot)));
+}
+
+//==============================================================================
+std::size_t FleetSnapshotPublisher::memory_bytes() const
+{
+  std::size_t bytes = _working.capacity() * sizeof(ColdFields)
+    + _updated.capacity() + _updated_slots.capacity() * sizeof(std::size_t)
+    + _published.capacity() * sizeof(FleetSnapshot::RobotPtr);
+
+  for (const auto& robot : _working)
+  {
+    bytes += heap_bytes(robot.name) + heap_bytes(robot.model)
+      + heap_bytes(robot.task_id);
+  }
+
+  // The control block of make_shared sits next to the robot
+  for (const auto& robot : _published)
+  {
+    if (!robot)
+      continue;
+
+    bytes += sizeof(RobotSnapshot) + 2 * sizeof(void*)
+      + heap_bytes(robot->name) + heap_bytes(robot->model)
+      + heap_bytes(robot->level_name) + heap_bytes(robot->task_id);
+  }
+
+  for (const auto& level : _level_slots)
+    bytes += level.second.capacity() * sizeof(std::size_t);
+
+  for (const auto& level : _levels)
+    bytes += level.second->robots.capacity() * sizeof(FleetSnapshot::RobotPtr);
+
+  return bytes;
+}
+
+//==============================================================================
+void FleetSnapshotPublisher::_rebuild_level(const std::string& level_name)
+{
+  const auto slots = _level_slots.find(level_name);
+  if (slots == _level_slots.end() || slots->second.empty())
+  {
+    if (slots != _level_slots.end())
+      _level_slots.erase(slots);
+
+    _levels.erase(level_name);
+    return;
+  }
+
+  auto level = std::make_shared<FleetSnapshot::Level>();
+  level->name = level_name;
+  level->robots.reserve(slots->second.size());
+  for (const std::size_t slot : slots->second)
+    level->robots.push_back(_published[slot]);
+
+  _levels[level_name] = std::move(level);
+}
+
+//==============================================================================
+std::shared_ptr<const FleetSnapshot> FleetSnapshotPublisher::latest() const
+{
+  return std::atomic_load(&_latest);
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__FLEET_SNAPSHOT_HPP
+#define SRC__RMF_ADAPTER__FLEET_SNAPSHOT_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <free_fleet/messages/RobotState.hpp>
+
+#include "robot_state_table.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// The last accepted state of one robot
+struct RobotSnapshot
+{
+  std::string name;
+  std::string model;
+  std::string level_name;
+  double x = 0.0;
+  double y = 0.0;
+  double yaw = 0.0;
+  uint32_t mode = 0;
+  std::string task_id;
+  double battery_percent = 0.0;
+
+  /// Adapter time in nanoseconds when the state arrived
+  int64_t last_seen = 0;
+};
+
+//==============================================================================
+/// An immutable picture of the whole fleet at the end of one drain. Robots are
+/// grouped by level, in slot order within each level. A snapshot shares the
+/// robots and levels that did not change with the snapshot before it, so
+/// publishing one only copies what was updated.
+class FleetSnapshot
+{
+public:
+
+  using RobotPtr = std::shared_ptr<const RobotSnapshot>;
+
+  /// The robots on one level
+  struct Level
+  {
+    std::string name;
+    std::vector<RobotPtr> robots;
+  };
+
+  using LevelPtr = std::shared_ptr<const Level>;
+
+  /// A range of robots within a snapshot
+  struct Page
+  {
+    std::vector<const RobotSnapshot*> robots;
+
+    /// Number of robots that matched the filter, across every page
+    std::size_t total = 0;
+  };
+
+  /// Increases by one with every published snapshot
+  uint64_t version() const;
+
+  /// Adapter time in nanoseconds when the snapshot was published
+  int64_t stamp() const;
+
+  /// The levels that have robots on them, sorted by name
+  const std::vector<LevelPtr>& levels() const;
+
+  /// Number of robots across every level
+  std::size_t size() const;
+
+  /// Get up to limit robots, starting at offset, among the robots on the
+  /// given level. An empty level name matches every level, and a limit of
+  /// zero means no limit.
+  Page page(
+    const std::string& level_name,
+    std::size_t offset,
+    std::size_t limit) const;
+
+private:
+  friend class FleetSnapshotPublisher;
+
+  uint64_t _version = 0;
+  int64_t _stamp = 0;
+  std::size_t _size = 0;
+  std::vector<LevelPtr> _levels;
+};
+
+//==============================================================================
+/// Keeps the fields of each robot that the RobotStateTable does not hold, and
+/// turns them together with the table into a new immutable snapshot at the
+/// end of each drain. Readers on any thread get the latest snapshot with an
+/// atomic load, so they never take the ingestion lock and never see a
+/// snapshot change underneath them.
+class FleetSnapshotPublisher
+{
+public:
+
+  FleetSnapshotPublisher();
+
+  /// Record the accepted state of the robot in a slot. The position, level,
+  /// mode and arrival time are read from the table when publishing, so the
+  /// table must have been updated with the same state. Only the ingestion
+  /// thread may call this.
+  void update(std::size_t slot, const messages::RobotState& state);
+
+  /// Publish a new snapshot if anything was updated since the last one. Only
+  /// the robots that were updated are copied, and only the levels that they
+  /// are on or left are rebuilt. Only the ingestion thread may call this.
+  void publish(const RobotStateTable& table, int64_t now_ns);
+
+  /// Bytes that the publisher holds, including the robots of the latest
+  /// snapshot. Only the ingestion thread may call this.
+  std::size_t memory_bytes() const;
+
+  /// The latest published snapshot. Safe to call from any thread.
+  std::shared_ptr<const FleetSnapshot> latest() const;
+
+private:
+
+  /// Rebuild the level of the published snapshot with the current robots of
+  /// the level
+  void _rebuild_level(const std::string& level_name);
+
+  /// The fields of a robot that the table does not keep
+  struct ColdFields
+  {
+    std::string name;
+    std::string model;
+    std::string task_id;
+    double battery_percent = 0.0;
+  };
+
+  std::vector<ColdFields> _working;
+  std::vector<uint8_t> _updated;
+  std::vector<std::size_t> _updated_slots;
+
+  /// What the latest snapshot holds for each slot
+  std::vector<FleetSnapshot::RobotPtr> _published;
+
+  /// Slots of the robots on each level, in slot order, and the levels of the
+  /// latest snapshot
+  std::unordered_map<std::string, std::vector<std::size_t>> _level_slots;
+  std::map<std::string, FleetSnapshot::LevelPtr> _levels;
+
+  uint64_t _version = 0;
+  std::shared_ptr<const FleetSnapshot> _latest;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__FLEET_SNAPSHOT_HPP
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Measures how much memory the per-robot state of the adapter takes: the hot
+// state table and the fleet snapshots, filled with synthetic robots spread
+// over a few levels. Both the accounted bytes and the growth of the resident
+// memory are reported per robot, along with the time one drain takes to
+// update every robot and publish a snapshot.
+//
+// Usage: footprint_benchmark [--levels L] [--drains D] [robots...]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "fleet_snapshot.hpp"
+#include "robot_state_table.hpp"
+
+namespace {
+
+//==============================================================================
+struct Options
+{
+  std::vector<std::size_t> robots;
+  std::size_t levels = 4;
+  std::size_t drains = 20;
+};
+
+//==============================================================================
+/// Resident memory of this process in bytes
+std::size_t resident_bytes()
+{
+  std::ifstream statm("/proc/self/statm");
+  std::size_t total = 0;
+  std::size_t resident = 0;
+  statm >> total >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+//==============================================================================
+bool parse_options(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--levels" && has_value)
+      options.levels = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--drains" && has_value)
+      options.drains = std::strtoul(argv[++i], nullptr, 10);
+    else if (!arg.empty() && arg[0] != '-')
+      options.robots.push_back(std::strtoul(arg.c_str(), nullptr, 10));
+    else
+      return false;
+  }
+
+  if (options.robots.empty())
+    options.robots = {100, 1000, 10000, 100000};
+
+  return options.levels > 0 && options.drains > 0;
+}
+
+//==============================================================================
+free_fleet::messages::RobotState make_state(
+  std::size_t robot,
+  std::size_t levels)
+{
+  free_fleet::messages::RobotState state{};
+  state.name = "robot_" + std::to_string(robot);
+  state.model = "synthetic_model";
+  state.task_id = "0";
+  state.battery_percent = 80.0;
+  state.mode.mode = free_fleet::messages::RobotMode::MODE_MOVING;
+  state.location.level_name = "L" + std::to_string(robot % levels);
+  state.location.x = static_cast<double>(robot % 100);
+  state.location.y = static_cast<double>(robot / 100);
+  state.location.yaw = 0.0;
+  return state;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    std::fprintf(
+      stderr, "Usage: %s [--levels L] [--drains D] [robots...]\n", argv[0]);
+    return 1;
+  }
+
+  std::printf(
+    "%10s %10s %10s %10s %10s %12s\n",
+    "robots", "hot B", "table B", "snapshot B", "rss B", "drain us");
+
+  for (const std::size_t robots : options.robots)
+  {
+    // States are built up front, so that the resident memory and the drain
+    // time only cover the adapter's own work
+    std::vector<free_fleet::messages::RobotState> states;
+    states.reserve(robots);
+    for (std::size_t r = 0; r < robots; ++r)
+      states.push_back(make_state(r, options.levels));
+
+    const std::size_t baseline = resident_bytes();
+    double drain_us = 0.0;
+    std::size_t table_bytes = 0;
+    std::size_t snapshot_bytes = 0;
+    std::size_t resident = 0;
+    {
+      free_fleet::rmf::RobotStateTable table;
+      free_fleet::rmf::FleetSnapshotPublisher snapshots;
+      table.reserve(robots);
+
+      for (std::size_t d = 0; d < options.drains; ++d)
+      {
+        for (auto& state : states)
+          state.location.x += 0.1;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& state : states)
+        {
+          const auto slot = table.insert(state.name).first;
+          table.update(slot, state, static_cast<int64_t>(d));
+          snapshots.update(slot, state);
+        }
+        snapshots.publish(table, static_cast<int64_t>(d));
+        const auto finish = std::chrono::steady_clock::now();
+
+        drain_us += std::chrono::duration<double, std::micro>(
+          finish - start).count();
+      }
+
+      resident = resident_bytes();
+      table_bytes = table.memory_bytes();
+      snapshot_bytes = snapshots.memory_bytes();
+    }
+
+    const std::size_t grown = resident > baseline ? resident - baseline : 0;
+    std::printf(
+      "%10zu %10zu %10zu %10zu %10zu %12.1f\n",
+      robots, free_fleet::rmf::RobotStateTable::bytes_per_robot(),
+      table_bytes / robots, snapshot_bytes / robots, grown / robots,
+      drain_us / static_cast<double>(options.drains));
+  }
+
+  return 0;
+}
@@ -16,25 +16,118 @@
 */
 
 #include <mutex>
-#include <thread>
-#include <iostream>
+#include <atomic>
+#include <algorithm>
 
+#include <free_fleet/messages/ModeParameter.hpp>
 #include <free_fleet/messages/ModeRequest.hpp>
 #include <free_fleet/messages/NavigationRequest.hpp>
 
-#include <free_fleet_cyclonedds/CycloneDDSMiddleware.hpp>
-
-#include <rmf_fleet_adapter/agv/Adapter.hpp>
-#include <rmf_fleet_adapter/agv/parse_graph.hpp>
-
 #include <rmf_traffic_ros2/Time.hpp>
 
 #include "full_control.hpp"
-#include "load_param.hpp"
+#include "monotonic_arena.hpp"
+#include "path_phase.hpp"
+#include "robot_state_table.hpp"
+#include "robot_task.hpp"
 
 namespace free_fleet {
 namespace rmf {
 
+//==============================================================================
+/// Follows the current path of a robot: sends the navigation request, retries
+/// it until the robot acknowledges it, and then tracks the progress that the
+/// robot reports until the path is finished.
+class FollowPathTask : public RobotTask<FollowPathTask>
+{
+public:
+
+  enum Step : int
+  {
+    SendRequest = Begin,
+    WaitForAck,
+    FollowPath
+  };
+
+  FollowPathTask(FullControlHandle::Implementation& impl)
+  : _impl(&impl)
+  {}
+
+private:
+
+  friend class RobotTask<FollowPathTask>;
+
+  void _run(TaskEvent event, const messages::RobotState* state);
+
+  void _send();
+
+  FullControlHandle::Implementation* _impl;
+  std::size_t _attempts = 0;
+};
+
+//==============================================================================
+/// Sends a docking request to a robot and waits for the robot to leave the
+/// docking mode again.
+class DockTask : public RobotTask<DockTask>
+{
+public:
+
+  enum Step : int
+  {
+    SendRequest = Begin,
+    WaitForAck,
+    Docking
+  };
+
+  DockTask(FullControlHandle::Implementation& impl)
+  : _impl(&impl)
+  {}
+
+  std::string dock_name;
+
+private:
+
+  friend class RobotTask<DockTask>;
+
+  void _run(TaskEvent event, const messages::RobotState* state);
+
+  void _send();
+
+  FullControlHandle::Implementation* _impl;
+  std::size_t _attempts = 0;
+  std::string _task_id;
+};
+
+//==============================================================================
+/// Sends a pause request to a robot and resends it until the robot reports
+/// that it has paused or has taken on the request.
+class StopTask : public RobotTask<StopTask>
+{
+public:
+
+  enum Step : int
+  {
+    SendRequest = Begin,
+    WaitForAck
+  };
+
+  StopTask(FullControlHandle::Implementation& impl)
+  : _impl(&impl)
+  {}
+
+private:
+
+  friend class RobotTask<StopTask>;
+
+  void _run(TaskEvent event, const messages::RobotState* state);
+
+  void _send();
+
+  FullControlHandle::Implementation* _impl;
+  std::size_t _attempts = 0;
+  std::string _task_id;
+};
+
 //==============================================================================
 class FullControlHandle::Implementation
 {
@@ -44,287 +137,1096 @@ public:
     rmf_fleet_adapter::agv::RobotCommandHandle::ArrivalEstimator;
   using RequestCompleted =
     rmf_fleet_adapter::agv::RobotCommandHandle::RequestCompleted;
+  using Waypoint = rmf_traffic::agv::Plan::Waypoint;
+
+  /// Bookkeeping for each location that gets sent to the robot
+  struct PathProgress
+  {
+    /// Index of the corresponding waypoint in the plan that RMF gave us
+    std::size_t plan_index;
+
+    /// Whether the robot has reported that it is past this location
+    bool reached;
+  };
+
+  Implementation(std::size_t path_arena_capacity)
+  : _path_arena(path_arena_capacity),
+    _waypoints(ArenaAllocator<Waypoint>(_path_arena)),
+    _path_locations(ArenaAllocator<messages::Location>(_path_arena)),
+    _progress(ArenaAllocator<PathProgress>(_path_arena)),
+    _follow_path_task(*this),
+    _dock_task(*this),
+    _stop_task(*this)
+  {}
+
+  std::shared_ptr<const FleetContext> _context;
+
+  /// Storage for everything that belongs to the current path. This gets reset
+  /// whenever a new path is accepted.
+  MonotonicArena _path_arena;
 
-  rclcpp::Node* _node;
+  ArenaVector<Waypoint> _waypoints;
+  ArenaVector<messages::Location> _path_locations;
+  ArenaVector<PathProgress> _progress;
 
-  std::vector<rmf_traffic::agv::Plan::Waypoint> _waypoints;
   ArrivalEstimator _next_arrival_estimator;
   RequestCompleted _path_finished_callback;
+  RequestCompleted _docking_finished_callback;
   rmf_utils::optional<std::size_t> _last_known_wp;
+
+  /// The location of the current path that the robot arrived at last, as an
+  /// index into _progress, and when it did on the clock of the plans
+  rmf_utils::optional<std::size_t> _last_arrival;
+  rmf_traffic::Time _last_arrival_time;
+
+  /// Lanes between two locations of the path, reused between arrivals
+  std::vector<LaneStatistics::Traversal> _traversals;
   rmf_fleet_adapter::agv::RobotUpdateHandlePtr _updater;
-  std::shared_ptr<const rmf_traffic::agv::Graph> _graph;
-  std::shared_ptr<const rmf_traffic::agv::VehicleTraits> _traits;
-  std::shared_ptr<free_fleet::transport::Middleware> _free_fleet_middleware;
 
-  std::string _fleet_name;
   std::string _robot_name;
+  std::string _level_name;
+
+  /// The id that the fleet adapter uses when it asks for doors and lifts on
+  /// behalf of this robot
+  std::string _requester_id;
+
+  /// Doors and lifts of the current path that the robot has not reached yet
+  FacilityLookahead _facilities;
+
+  /// The requests are kept around so their strings and paths keep their
+  /// capacity between commands. They are only used without an outbox.
+  messages::NavigationRequest _navigation_request;
+  messages::ModeRequest _mode_request;
+  std::string _navigation_task_id;
+
+  /// The id of this robot's storage in the command outbox
+  std::size_t _outbox_id = 0;
 
   uint32_t _current_task_id = 0;
-};
 
-//==============================================================================
-FullControlHandle::FullControlHandle(
-  rclcpp::Node& node,
-  std::string fleet_name,
-  std::string robot_name,
-  std::shared_ptr<const rmf_traffic::agv::Graph> graph,
-  std::shared_ptr<const rmf_traffic::agv::VehicleTraits> traits,
-  std::shared_ptr<free_fleet::transport::Middleware> free_fleet_middleware)
-: _pimpl(rmf_utils::make_impl<Implementation>(Implementation()))
-{
-  _pimpl->_node = &node;
-  _pimpl->_fleet_name = std::move(fleet_name);
-  _pimpl->_robot_name = std::move(robot_name);
-  _pimpl->_graph = std::move(graph);
-  _pimpl->_traits = std::move(traits);
-  _pimpl->_free_fleet_middleware = std::move(free_fleet_middleware);
-}
+  /// The command routines of this robot. The phase decides which of them, if
+  /// any, is active.
+  FollowPathTask _follow_path_task;
+  DockTask _dock_task;
+  PathPhase _phase = PathPhase::Idle;
 
-//==============================================================================
-FullControlHandle::~FullControlHandle()
-{}
+  /// Runs alongside the phase, since a stopped robot is Idle as far as the
+  /// phase is concerned while its stop request is still unacknowledged
+  StopTask _stop_task;
 
-//==============================================================================
-void FullControlHandle::follow_new_path(
-  const std::vector<rmf_traffic::agv::Plan::Waypoint>& waypoints,
-  ArrivalEstimator next_arrival_estimator,
-  RequestCompleted path_finished_callback)
-{}
+  /// What to do with a new state in each phase, indexed by PathPhase
+  using StateHandler = void (Implementation::*)(
+    const messages::RobotState&, rmf_traffic::Time);
+  static const StateHandler _state_handlers[PathTransitions::NumPhases];
 
-//==============================================================================
-void FullControlHandle::stop()
-{
-  messages::ModeRequest request{
-    _pimpl->_robot_name,
-    std::to_string(_pimpl->_current_task_id++),
-    messages::RobotMode{messages::RobotMode::MODE_PAUSED},
-    {}};
-  _pimpl->_free_fleet_middleware->send_mode_request(request);
-}
+  /// The earliest of the active task's deadline and the pending path's flush
+  /// time, in nanoseconds of the steady clock. This is atomic so the timeout
+  /// check can skip robots without taking the lock.
+  std::atomic<int64_t> _wake_time{INT64_MAX};
 
-//==============================================================================
-void FullControlHandle::dock(
-  const std::string& dock_name,
-  RequestCompleted docking_finished_callback)
-{}
+  /// Paths that arrive within this long of the last transmitted path are held
+  /// back, and only the latest of them gets transmitted once it elapses.
+  rmf_traffic::Duration _debounce_window;
+  rmf_traffic::Time _last_path_sent;
 
-//==============================================================================
-void FullControlHandle::set_updater(
-  rmf_fleet_adapter::agv::RobotUpdateHandlePtr updater)
-{
-  _pimpl->_updater = std::move(updater);
-  // _pimpl->_start();
-}
+  /// The latest path that is being held back by the debounce window
+  bool _has_pending_path = false;
+  std::vector<Waypoint> _pending_waypoints;
+  ArrivalEstimator _pending_arrival_estimator;
+  RequestCompleted _pending_path_finished_callback;
+  rmf_traffic::Time _pending_flush_time;
 
-//==============================================================================
-void FullControlHandle::update_state(const messages::RobotState& new_state)
-{
-  if (!_pimpl->_updater)
-    return;
+  /// Number of paths that were replaced before they were ever transmitted
+  std::atomic<uint64_t> _suppressed_paths{0};
 
-  
-}
+  /// Stops of the robot between accepting a path and finishing it
+  TripStopCounter _trip_stops;
 
-//==============================================================================
-} // rmf
-} // namespace free_fleet
+  /// Callback of a finished request, to be triggered once the lock is released
+  RequestCompleted _completed;
 
-struct Connections : public std::enable_shared_from_this<Connections>
-{
-  /// The API for adding new robots to the adapter
-  rmf_fleet_adapter::agv::FleetUpdateHandlePtr fleet;
+  mutable std::mutex _mutex;
 
-  /// The API for running the fleet adapter
-  rmf_fleet_adapter::agv::AdapterPtr adapter;
+  void _clear_path()
+  {
+    // Everything living in the arena has to be destroyed before the reset.
+    _waypoints = ArenaVector<Waypoint>(ArenaAllocator<Waypoint>(_path_arena));
+    _path_locations = ArenaVector<messages::Location>(
+      ArenaAllocator<messages::Location>(_path_arena));
+    _progress =
+      ArenaVector<PathProgress>(ArenaAllocator<PathProgress>(_path_arena));
+    _path_arena.reset();
+  }
 
-  /// The navigation graph for the robot
-  std::shared_ptr<const rmf_traffic::agv::Graph> graph;
+  void _accept_path(const std::vector<Waypoint>& waypoints)
+  {
+    _clear_path();
+    _last_arrival = rmf_utils::nullopt;
 
-  /// The traits of the vehicles
-  std::shared_ptr<const rmf_traffic::agv::VehicleTraits> traits;
+    _waypoints.reserve(waypoints.size());
+    _path_locations.reserve(waypoints.size());
+    _progress.reserve(waypoints.size());
 
-  /// The container for robot update handles
-  std::unordered_map<std::string, 
-    std::shared_ptr<free_fleet::rmf::FullControlHandle>> robots;
+    _waypoints.assign(waypoints.begin(), waypoints.end());
 
-  /// Middleware for free fleet
-  std::shared_ptr<free_fleet::transport::Middleware> free_fleet_middleware;
+    // Only the waypoints that change how the robot moves get sent. Progress
+    // keeps the index into the full plan, since that is what RMF expects to
+    // hear about.
+    simplify_path(
+      _waypoints.data(), _waypoints.size(), _context->path_simplification,
+      [this](std::size_t i)
+      {
+        _path_locations.push_back(_make_location(_waypoints[i]));
+        _progress.push_back(PathProgress{i, false});
+      });
 
-  /// Timer that polls for all the incoming states
-  std::shared_ptr<rclcpp::TimerBase> timer;
-  
-  std::mutex mutex;
+    _plan_facilities();
+  }
 
-  void add_robot(
-    const std::string& fleet_name,
-    const free_fleet::messages::RobotState& state)
+  /// Find the doors and lifts of a newly accepted path
+  void _plan_facilities()
   {
-    const auto& robot_name = state.name;
-    const auto command = std::make_shared<free_fleet::rmf::FullControlHandle>(
-      *adapter->node(),
-      fleet_name,
-      robot_name,
-      graph,
-      traits,
-      free_fleet_middleware);
+    const auto& requester = _context->facility_requests;
+    if (!requester)
+      return;
 
+    _facilities.replan(
+      _waypoints.data(), _waypoints.size(),
+      [&](const FacilityEvent& event)
+      {
+        requester->release(event, _requester_id);
+      });
+  }
+
+  /// Send the requests for the doors and lifts that the robot will reach
+  /// within the lead time. The time must be on the clock of the plans.
+  void _request_facilities(rmf_traffic::Time now)
+  {
+    const auto& requester = _context->facility_requests;
+    if (!requester || _facilities.events().empty())
+      return;
+
+    // The plan gets shifted by how late the robot was at the last location
+    // it arrived at.
+    std::size_t next_plan_index = 0;
+    rmf_traffic::Duration delay(0);
+    if (_last_arrival)
+    {
+      const std::size_t arrived = _progress[*_last_arrival].plan_index;
+      next_plan_index = arrived + 1;
+      delay = std::max(
+        rmf_traffic::Duration(0),
+        _last_arrival_time - _waypoints[arrived].time());
+    }
+
+    _facilities.update(
+      next_plan_index, delay, now, requester->lead_time(),
+      [&](const FacilityEvent& event)
+      {
+        requester->request(event, _requester_id);
+      });
+  }
+
+  /// Withdraw the requests of doors and lifts that the robot will not reach
+  /// after all
+  void _release_facilities()
+  {
+    const auto& requester = _context->facility_requests;
+    if (!requester)
+      return;
+
+    _facilities.release_all(
+      [&](const FacilityEvent& event)
+      {
+        requester->release(event, _requester_id);
+      });
+  }
+
+  /// The current time on the clock that RMF schedules plans against, which
+  /// is the ROS clock and not the steady clock of the command deadlines
+  rmf_traffic::Time _plan_time() const
+  {
+    return rmf_traffic_ros2::convert(_context->node->now());
+  }
+
+  messages::Location _make_location(const Waypoint& wp) const
+  {
+    const auto p = wp.position();
+    const int64_t t =
+      rmf_traffic_ros2::convert(wp.time()).nanoseconds();
+
+    messages::Location location;
+    location.sec = static_cast<int32_t>(t / 1000000000);
+    location.nanosec = static_cast<uint32_t>(t % 1000000000);
+    location.x = p[0];
+    location.y = p[1];
+    location.yaw = p[2];
+    location.level_name = wp.graph_index() ?
+      _context->graph->get_waypoint(*wp.graph_index()).get_map_name() :
+      _level_name;
+    return location;
+  }
+
+  void _send_navigation_request()
+  {
+    _navigation_task_id = std::to_string(_current_task_id++);
+    const auto fill = [this](messages::NavigationRequest& request)
+      {
+        request.robot_name = _robot_name;
+        request.task_id = _navigation_task_id;
+        request.path.assign(_path_locations.begin(), _path_locations.end());
+      };
+
+    const auto& outbox = _context->outbox;
+    if (!outbox)
+    {
+      fill(_navigation_request);
+      _context->middleware->send_navigation_request(_navigation_request);
+      return;
+    }
+
+    auto loan = outbox->loan_navigation_request(_outbox_id);
+    fill(loan.request());
+    loan.commit();
+  }
+
+  /// Send a mode request with at most one parameter. An urgent request does
+  /// not wait for the next flush of the outbox.
+  void _send_mode_request(
+    const std::string& task_id,
+    uint32_t mode,
+    const char* parameter_name,
+    const std::string& parameter_value,
+    bool urgent)
+  {
+    const auto fill = [&](messages::ModeRequest& request)
+      {
+        request.robot_name = _robot_name;
+        request.task_id = task_id;
+        request.mode.mode = mode;
+        request.parameters.resize(parameter_name ? 1 : 0);
+        if (parameter_name)
+        {
+          request.parameters[0].name = parameter_name;
+          request.parameters[0].value = parameter_value;
+        }
+      };
+
+    const auto& outbox = _context->outbox;
+    if (!outbox)
+    {
+      fill(_mode_request);
+      _context->middleware->send_mode_request(_mode_request);
+      return;
+    }
+
+    {
+      auto loan = outbox->loan_mode_request(_outbox_id);
+      fill(loan.request());
+      loan.commit();
+    }
+
+    if (urgent)
+      outbox->flush();
+  }
+
+  /// Nominal time to travel between two points at the vehicle's nominal
+  /// speed
+  double _nominal_seconds(
+    const Eigen::Vector3d& from,
+    const Eigen::Vector3d& to) const
+  {
+    return (to.head<2>() - from.head<2>()).norm()
+      / _context->traits->linear().get_nominal_velocity();
+  }
+
+  /// Collect the lanes that the plan follows between two of its waypoints.
+  /// Path simplification keeps only the ends of straight runs, so there are
+  /// usually several lanes between two locations of the path. Returns false
+  /// if the plan leaves the graph in between.
+  bool _collect_lanes(std::size_t first, std::size_t last)
+  {
+    _traversals.clear();
+    for (std::size_t i = first; i < last; ++i)
+    {
+      const auto& from = _waypoints[i];
+      const auto& to = _waypoints[i + 1];
+      const double nominal = _nominal_seconds(from.position(), to.position());
+
+      // Turning in place or waiting does not traverse anything
+      if (nominal <= 1e-3)
+        continue;
+
+      if (!from.graph_index() || !to.graph_index()
+        || *from.graph_index() == *to.graph_index()
+        || !_context->graph->lane_from(*from.graph_index(), *to.graph_index()))
+        return false;
+
+      _traversals.push_back(
+        {*from.graph_index(), *to.graph_index(), nominal});
+    }
+
+    return !_traversals.empty();
+  }
+
+  /// Note that the robot arrived at a location of its path. If it came
+  /// straight from the location before it along the lanes of the plan, the
+  /// time it took teaches the lane statistics.
+  void _record_arrival(
+    std::size_t index,
+    bool skipped_locations,
+    rmf_traffic::Time now)
+  {
+    const auto previous = _last_arrival;
+    const auto previous_time = _last_arrival_time;
+    _last_arrival = index;
+    _last_arrival_time = now;
+
+    const auto& stats = _context->lane_statistics;
+    if (!stats || !previous || skipped_locations || *previous + 1 != index)
+      return;
+
+    const std::size_t first = _progress[*previous].plan_index;
+    const std::size_t last = _progress[index].plan_index;
+    if (!_collect_lanes(first, last))
+      return;
+
+    double nominal = 0.0;
+    for (const auto& lane : _traversals)
+      nominal += lane.nominal;
+
+    // Plans that hold the robot somewhere along the lanes say nothing about
+    // how fast the lanes can be traversed.
+    const double planned = rmf_traffic::time::to_seconds(
+      _waypoints[last].time() - _waypoints[first].time());
+    if (planned > 2.0 * nominal + 1.0)
+      return;
+
+    // Anything far outside of the nominal time is a robot that was stopped
+    // or a location that got reported late, not a property of the lanes.
+    const double observed = rmf_traffic::time::to_seconds(now - previous_time);
+    const double ratio = observed / nominal;
+    if (ratio < 0.2 || ratio > 10.0)
+      return;
+
+    stats->observe(_traversals, observed);
+  }
+
+  void _update_position(const messages::RobotState& state)
+  {
     const auto& loc = state.location;
-    fleet->add_robot(
-      command,
-      robot_name,
-      traits->profile(),
-      rmf_traffic::agv::compute_plan_starts(
-        *graph,
-        state.location.level_name,
-        {loc.x, loc.y, loc.y},
-        rmf_traffic_ros2::convert(adapter->node()->now())),
-      [c = weak_from_this(), command, robot_name = std::move(robot_name)](
-        const rmf_fleet_adapter::agv::RobotUpdateHandlePtr& updater)
+    _updater->update_position(
+      _level_name, Eigen::Vector3d{loc.x, loc.y, loc.yaw});
+  }
+
+  void _apply(PathInput input)
+  {
+    _phase = PathTransitions::next(_phase, input);
+  }
+
+  /// The task that the current phase belongs to, if any
+  TaskFrame* _active_task()
+  {
+    switch (_phase)
     {
-      const auto connections = c.lock();
-      if (!connections)
-        return;
+      case PathPhase::Navigating:
+      case PathPhase::Waiting:
+        return &_follow_path_task;
+      case PathPhase::Docking:
+        return &_dock_task;
+      default:
+        return nullptr;
+    }
+  }
 
-      std::lock_guard<std::mutex> lock(connections->mutex);
+  void _start_follow_path()
+  {
+    _stop_task.cancel();
+    _dock_task.cancel();
+    // A replan, or a path after a stop, continues the trip that the robot is
+    // on, since the stops it causes are what the trip should count.
+    if (!_trip_stops.in_trip())
+      _trip_stops.begin_trip();
 
-      command->set_updater(updater);
-      connections->robots[robot_name] = command;
-    });
+    _apply(PathInput::PathAccepted);
+    _follow_path_task.start(std::chrono::steady_clock::now());
+    _after_follow_path();
   }
-};
 
-//==============================================================================
-std::shared_ptr<Connections> make_fleet(
-  const rmf_fleet_adapter::agv::AdapterPtr& adapter)
-{
-  const auto& node = adapter->node();
-  std::shared_ptr<Connections> connections = std::make_shared<Connections>();
-  connections->adapter = adapter;
+  void _start_dock()
+  {
+    _release_facilities();
+    _stop_task.cancel();
+    _follow_path_task.cancel();
+    _trip_stops.end_trip();
+    _apply(PathInput::DockRequested);
+    _dock_task.start(std::chrono::steady_clock::now());
+    _after_dock();
+  }
 
-  const std::string dds_domain_id_param_name = "dds_domain";
-  const int dds_domain = node->declare_parameter(
-    dds_domain_id_param_name, -1);
-  if (dds_domain == -1)
+  void _cancel_task()
   {
-    RCLCPP_ERROR(
-      node->get_logger(),
-      "Missing [%s] parameter", dds_domain_id_param_name.c_str());
-    return nullptr;
+    _release_facilities();
+    _follow_path_task.cancel();
+    _dock_task.cancel();
+    _apply(PathInput::Stopped);
+    _sync_deadline();
   }
 
-  const std::string fleet_name_param_name = "fleet_name";
-  const std::string fleet_name = node->declare_parameter(
-    fleet_name_param_name, std::string());
-  if (fleet_name.empty())
+  /// Feed the outcome of the follow path routine back into the phase
+  void _after_follow_path()
   {
-    RCLCPP_ERROR(
-      node->get_logger(),
-      "Missing [%s] parameter", fleet_name_param_name.c_str());
-    return nullptr;
+    if (_follow_path_task.done())
+    {
+      if (!_follow_path_task.succeeded())
+        _release_facilities();
+
+      _trip_stops.end_trip();
+
+      _apply(_follow_path_task.succeeded() ?
+        PathInput::PathCompleted : PathInput::Abandoned);
+    }
+
+    _sync_deadline();
+  }
+
+  /// Feed the outcome of the docking routine back into the phase
+  void _after_dock()
+  {
+    if (_dock_task.done())
+    {
+      _apply(_dock_task.succeeded() ?
+        PathInput::DockCompleted : PathInput::Abandoned);
+    }
+
+    _sync_deadline();
   }
 
-  connections->traits =
-    std::make_shared<rmf_traffic::agv::VehicleTraits>(
-      free_fleet::rmf::get_traits_or_default(
-        *node, 0.7, 0.3, 0.5, 1.5, 0.5, 1.5));
+  void _sync_deadline()
+  {
+    const TaskFrame* task = _active_task();
+    rmf_traffic::Time wake_time = task ?
+      task->deadline() : rmf_traffic::Time::max();
+    wake_time = std::min(wake_time, _stop_task.deadline());
+    if (_has_pending_path)
+      wake_time = std::min(wake_time, _pending_flush_time);
+
+    _wake_time = wake_time.time_since_epoch().count();
+  }
+
+  /// Make a path the one that the robot follows and transmit it
+  void _commit_path(
+    const std::vector<Waypoint>& waypoints,
+    ArrivalEstimator next_arrival_estimator,
+    RequestCompleted path_finished_callback,
+    rmf_traffic::Time now)
+  {
+    _accept_path(waypoints);
+    _next_arrival_estimator = std::move(next_arrival_estimator);
+    _path_finished_callback = std::move(path_finished_callback);
+    _last_path_sent = now;
+    _start_follow_path();
+    _request_facilities(_plan_time());
+  }
 
-  const std::string nav_graph_param_name = "nav_graph_file";
-  const std::string graph_file =
-    node->declare_parameter(nav_graph_param_name, std::string());
-  if (graph_file.empty())
+  /// Drop the path that is being held back, if there is one
+  void _discard_pending_path()
+  {
+    if (!_has_pending_path)
+      return;
+
+    ++_suppressed_paths;
+    _has_pending_path = false;
+    _pending_arrival_estimator = nullptr;
+    _pending_path_finished_callback = nullptr;
+    _sync_deadline();
+  }
+
+  void _flush_pending_path(rmf_traffic::Time now)
+  {
+    _has_pending_path = false;
+    _commit_path(
+      _pending_waypoints,
+      std::move(_pending_arrival_estimator),
+      std::move(_pending_path_finished_callback),
+      now);
+    _pending_arrival_estimator = nullptr;
+    _pending_path_finished_callback = nullptr;
+  }
+
+  static double _path_length(
+    const Waypoint* begin,
+    const Waypoint* end)
+  {
+    double length = 0.0;
+    for (const Waypoint* wp = begin; wp != end && wp + 1 != end; ++wp)
+      length += ((wp + 1)->position().head<2>() - wp->position().head<2>())
+        .norm();
+    return length;
+  }
+
+  /// The index into the current plan of the waypoint that the robot left
+  /// last, if the robot is following a path that it has not finished yet
+  rmf_utils::optional<std::size_t> _first_upcoming() const
+  {
+    if (!PathTransitions::is_active(_phase) || _waypoints.empty())
+      return rmf_utils::nullopt;
+
+    std::size_t next = 0;
+    while (next < _progress.size() && _progress[next].reached)
+      ++next;
+
+    if (next >= _progress.size())
+      return rmf_utils::nullopt;
+
+    return next == 0 ? 0 : _progress[next - 1].plan_index;
+  }
+
+  /// True if a new path would bring the robot to a halt before the path that
+  /// it is currently following does
+  bool _stops_earlier(const std::vector<Waypoint>& waypoints) const
+  {
+    const auto first = _first_upcoming();
+    if (!first)
+      return false;
+
+    const double remaining = _path_length(
+      _waypoints.data() + *first, _waypoints.data() + _waypoints.size());
+    const double proposed = _path_length(
+      waypoints.data(), waypoints.data() + waypoints.size());
+
+    return proposed + 1e-3 < remaining;
+  }
+
+  /// True if a new path reaches any of the upcoming waypoints of the current
+  /// path later than the current path does. This is how negotiations usually
+  /// resolve a conflict: the route stays the same, and a wait lets another
+  /// robot pass first.
+  bool _arrives_later(const std::vector<Waypoint>& waypoints) const
+  {
+    const auto first = _first_upcoming();
+    if (!first)
+      return false;
+
+    // Both plans visit their waypoints in order, so the new plan is searched
+    // from just past the previous match. A wait shows up as two waypoints at
+    // the same place, which get matched pairwise.
+    const auto tolerance = std::chrono::milliseconds(100);
+    std::size_t search = 0;
+    for (std::size_t i = *first; i < _waypoints.size(); ++i)
+    {
+      const auto& current = _waypoints[i];
+      for (std::size_t j = search; j < waypoints.size(); ++j)
+      {
+        const auto& proposed = waypoints[j];
+        if ((proposed.position().head<2>() - current.position().head<2>())
+          .norm() > 1e-2)
+          continue;
+
+        if (proposed.time() > current.time() + tolerance)
+          return true;
+
+        search = j + 1;
+        break;
+      }
+    }
+
+    return false;
+  }
+
+  static TaskEvent _event_for(
+    const TaskFrame& task,
+    const messages::RobotState& state)
+  {
+    const auto& awaited = task.awaited_task_id();
+    return !awaited.empty() && state.task_id == awaited ?
+      TaskEvent::AckReceived : TaskEvent::StateArrived;
+  }
+
+  void _handle_idle_state(
+    const messages::RobotState& state,
+    rmf_traffic::Time)
+  {
+    _update_position(state);
+  }
+
+  void _handle_path_state(
+    const messages::RobotState& state,
+    rmf_traffic::Time now)
+  {
+    _apply(PathTransitions::from_mode(state.mode.mode));
+    _follow_path_task.resume(
+      _event_for(_follow_path_task, state), &state, now);
+    _after_follow_path();
+    _request_facilities(_plan_time());
+  }
+
+  void _handle_dock_state(
+    const messages::RobotState& state,
+    rmf_traffic::Time now)
+  {
+    _dock_task.resume(_event_for(_dock_task, state), &state, now);
+    _after_dock();
+  }
+
+  void _handle_timeout(rmf_traffic::Time now)
+  {
+    if (_phase == PathPhase::Docking)
+    {
+      _dock_task.resume(TaskEvent::Timeout, nullptr, now);
+      _after_dock();
+    }
+    else if (PathTransitions::is_active(_phase))
+    {
+      _follow_path_task.resume(TaskEvent::Timeout, nullptr, now);
+      _after_follow_path();
+    }
+  }
+
+  /// Give up on a command that the robot never acknowledged, and let RMF
+  /// replan for the robot.
+  void _interrupt(const char* command)
   {
     RCLCPP_ERROR(
-      node->get_logger(),
-      "Missing [%s] parameter", nav_graph_param_name.c_str());
-    return nullptr;
+      _context->node->get_logger(),
+      "Robot [%s] did not acknowledge the %s request after %zu attempts",
+      _robot_name.c_str(), command, _context->command_retries + 1);
+
+    if (_updater)
+      _updater->interrupted();
   }
+};
 
-  connections->graph =
-    std::make_shared<rmf_traffic::agv::Graph>(
-      rmf_fleet_adapter::agv::parse_graph(graph_file, *connections->traits));
+//==============================================================================
+void FollowPathTask::_send()
+{
+  _impl->_send_navigation_request();
+  _await_ack(
+    _impl->_navigation_task_id,
+    WaitForAck,
+    _impl->_context->command_ack_timeout);
+}
 
-  std::cout << "The fleet [" << fleet_name
-            << "] has the following named waypoints:\n";
-  for (const auto& key : connections->graph->keys())
-    std::cout << " -- " << key.first << std::endl;
+//==============================================================================
+void FollowPathTask::_run(
+  TaskEvent event,
+  const messages::RobotState* state)
+{
+  switch (_step)
+  {
+    case SendRequest:
+    {
+      _attempts = 0;
+      _send();
+      return;
+    }
+    case WaitForAck:
+    {
+      if (event == TaskEvent::Timeout)
+      {
+        if (++_attempts > _impl->_context->command_retries)
+        {
+          _impl->_interrupt("navigation");
+          _abandon();
+          return;
+        }
 
-  connections->fleet = adapter->add_fleet(
-    fleet_name, *connections->traits, *connections->graph);
+        _send();
+        return;
+      }
 
-  // If the perform_deliveries parameter is true, then we just blindly accept
-  // all delivery requests.
-  if (node->declare_parameter<bool>("perform_deliveries", false))
+      if (event != TaskEvent::AckReceived)
+      {
+        _impl->_update_position(*state);
+        return;
+      }
+
+      _await_state(FollowPath);
+      break;
+    }
+    case FollowPath:
+    {
+      if (state->task_id != _impl->_navigation_task_id)
+      {
+        _impl->_update_position(*state);
+        return;
+      }
+
+      break;
+    }
+    default:
+      return;
+  }
+
+  // The robot drops locations from its reported path as it passes them, so
+  // whatever is left tells us how far along it is.
+  const auto& loc = state->location;
+  const Eigen::Vector3d position{loc.x, loc.y, loc.yaw};
+  const std::size_t total = _impl->_progress.size();
+  const std::size_t remaining = std::min(state->path.size(), total);
+  const std::size_t target = total - remaining;
+  std::size_t newly_reached = 0;
+  for (std::size_t i = 0; i < target; ++i)
   {
-    connections->fleet->accept_delivery_requests(
-      [](const rmf_task_msgs::msg::Delivery&){ return true; });
+    auto& progress = _impl->_progress[i];
+    if (progress.reached)
+      continue;
+
+    progress.reached = true;
+    ++newly_reached;
+    const auto& wp = _impl->_waypoints[progress.plan_index];
+    if (wp.graph_index())
+      _impl->_last_known_wp = *wp.graph_index();
   }
 
-  if (node->declare_parameter<bool>("disable_delay_threshold", false))
+  if (newly_reached > 0)
+    _impl->_record_arrival(
+      target - 1, newly_reached > 1, _impl->_plan_time());
+
+  if (remaining == 0)
   {
-    connections->fleet->default_maximum_delay(rmf_utils::nullopt);
+    _impl->_updater->update_position(_impl->_level_name, position);
+    // RMF has already replaced this path if a newer one is held back, so
+    // finishing it must not be reported. The newer path reports its own.
+    if (!_impl->_has_pending_path)
+      _impl->_completed = std::move(_impl->_path_finished_callback);
+    _impl->_path_finished_callback = nullptr;
+    _impl->_next_arrival_estimator = nullptr;
+    // The fleet adapter takes over the doors and lifts at the end of a path.
+    _impl->_facilities.hand_over();
+    _impl->_clear_path();
+    _finish();
+    return;
   }
+
+  const auto& progress = _impl->_progress[target];
+  const auto& wp = _impl->_waypoints[progress.plan_index];
+  if (wp.graph_index())
+    _impl->_updater->update_position(position, *wp.graph_index());
   else
+    _impl->_updater->update_position(_impl->_level_name, position);
+
+  if (_impl->_next_arrival_estimator)
   {
-    connections->fleet->default_maximum_delay(
-      free_fleet::rmf::get_parameter_or_default_time(
-        *node, "delay_threshold", 10.0));
+    double seconds = _impl->_nominal_seconds(position, wp.position());
+
+    // Scale by how much slower or faster robots have been on the lanes
+    // towards the next location.
+    const auto& stats = _impl->_context->lane_statistics;
+    if (stats && target > 0)
+    {
+      const std::size_t first = _impl->_progress[target - 1].plan_index;
+      if (_impl->_collect_lanes(first, progress.plan_index))
+        seconds *= stats->ratio(_impl->_traversals);
+    }
+
+    _impl->_next_arrival_estimator(
+      progress.plan_index, rmf_traffic::time::from_seconds(seconds));
   }
+}
 
-  connections->free_fleet_middleware =
-    free_fleet::cyclonedds::CycloneDDSMiddleware::make_server(
-      dds_domain, fleet_name);
+//==============================================================================
+void DockTask::_send()
+{
+  _task_id = std::to_string(_impl->_current_task_id++);
+  _impl->_send_mode_request(
+    _task_id, messages::RobotMode::MODE_DOCKING, "docking", dock_name, false);
+  _await_ack(_task_id, WaitForAck, _impl->_context->command_ack_timeout);
+}
 
-  connections->timer =
-   node->create_wall_timer(
-     std::chrono::milliseconds(100),
-     [c = std::weak_ptr<Connections>(connections), fleet_name]()
+//==============================================================================
+void DockTask::_run(TaskEvent event, const messages::RobotState* state)
+{
+  switch (_step)
   {
-    const auto connections = c.lock();
-    if (!connections)
+    case SendRequest:
+    {
+      _attempts = 0;
+      _send();
       return;
-
-    auto new_states = connections->free_fleet_middleware->read_states();
-    for (const auto s : new_states)
+    }
+    case WaitForAck:
     {
-      if (s)
+      if (event == TaskEvent::Timeout)
       {
-        const auto insertion = connections->robots.insert({state.name, nullptr});
-        const bool new_robot = insertion.second;
-        if (new_robot)
+        if (++_attempts > _impl->_context->command_retries)
         {
-          connections->add_robot(fleet_name, *s);
+          _impl->_interrupt("docking");
+          _abandon();
+          return;
         }
 
-        const auto& command = insertion.first->second;
-        if (command)
+        _send();
+        return;
+      }
+
+      _impl->_update_position(*state);
+      if (event == TaskEvent::AckReceived)
+        _await_state(Docking);
+
+      return;
+    }
+    case Docking:
+    {
+      _impl->_update_position(*state);
+      if (state->task_id == _task_id
+        && state->mode.mode == messages::RobotMode::MODE_DOCKING)
+        return;
+
+      _impl->_completed = std::move(_impl->_docking_finished_callback);
+      _impl->_docking_finished_callback = nullptr;
+      _finish();
+      return;
+    }
+    default:
+      return;
+  }
+}
+
+//==============================================================================
+void StopTask::_send()
+{
+  _task_id = std::to_string(_impl->_current_task_id++);
+
+  // Stopping is safety relevant, so it never waits for the outbox.
+  _impl->_send_mode_request(
+    _task_id, messages::RobotMode::MODE_PAUSED, nullptr, std::string(), true);
+
+  if (_impl->_context->reliable_stop)
+    _await_ack(_task_id, WaitForAck, _impl->_context->command_ack_timeout);
+  else
+    _finish();
+}
+
+//==============================================================================
+void StopTask::_run(TaskEvent event, const messages::RobotState* state)
+{
+  switch (_step)
+  {
+    case SendRequest:
+    {
+      _attempts = 0;
+      _send();
+      return;
+    }
+    case WaitForAck:
+    {
+      if (event == TaskEvent::Timeout)
+      {
+        if (++_attempts > _impl->_context->command_retries)
         {
-          command->update_state(*s);
+          RCLCPP_ERROR(
+            _impl->_context->node->get_logger(),
+            "Robot [%s] did not acknowledge the stop request after %zu "
+            "attempts", _impl->_robot_name.c_str(),
+            _impl->_context->command_retries + 1);
+          _abandon();
+          return;
         }
+
+        _send();
+        return;
       }
+
+      if (event == TaskEvent::AckReceived
+        || state->mode.mode == messages::RobotMode::MODE_PAUSED)
+        _finish();
+
+      return;
     }
-  }); 
+    default:
+      return;
+  }
+}
 
-  return connections;
+//==============================================================================
+FullControlHandle::FullControlHandle(
+  std::shared_ptr<const FleetContext> context,
+  std::string robot_name)
+: _pimpl(rmf_utils::make_unique_impl<Implementation>(
+      context->path_arena_capacity))
+{
+  _pimpl->_debounce_window = context->path_debounce_window;
+  _pimpl->_context = std::move(context);
+  _pimpl->_robot_name = std::move(robot_name);
+  _pimpl->_requester_id =
+    _pimpl->_context->fleet_name + "/" + _pimpl->_robot_name;
+  if (_pimpl->_context->outbox)
+    _pimpl->_outbox_id = _pimpl->_context->outbox->add_robot();
 }
 
 //==============================================================================
-int main(int argc, char** argv)
+FullControlHandle::~FullControlHandle()
+{}
+
+//==============================================================================
+void FullControlHandle::follow_new_path(
+  const std::vector<rmf_traffic::agv::Plan::Waypoint>& waypoints,
+  ArrivalEstimator next_arrival_estimator,
+  RequestCompleted path_finished_callback)
 {
-  rclcpp::init(argc, argv);
-  const auto adapter = rmf_fleet_adapter::agv::Adapter::make("fleet_adapter");
-  if (!adapter)
-    return 1;
+  const CallbackWatchdog::Scope timing(
+    _pimpl->_context->watchdog.get(), Callback::FollowPath,
+    &_pimpl->_robot_name);
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  auto& impl = *_pimpl;
+  const auto now = std::chrono::steady_clock::now();
 
-  const auto fleet_connections = make_fleet(adapter);
-  if (!fleet_connections)
-    return 1;
-  
-  RCLCPP_INFO(adapter->node()->get_logger(), "Starting Fleet Adapter");
+  // During negotiations RMF may replace a path several times in quick
+  // succession. Only the last of a burst gets transmitted, unless a path would
+  // stop the robot sooner or hold it back longer than the one it is already
+  // following. Such changes keep robots apart, so they never wait.
+  const auto hold_until = impl._last_path_sent + impl._debounce_window;
+  if (now < hold_until && !impl._stops_earlier(waypoints)
+    && !impl._arrives_later(waypoints))
+  {
+    if (impl._has_pending_path)
+      ++impl._suppressed_paths;
 
-  // Start running the adapter and wait until it gets stopped by SIGINT
-  adapter->start().wait();
+    impl._has_pending_path = true;
+    impl._pending_waypoints.assign(waypoints.begin(), waypoints.end());
+    impl._pending_arrival_estimator = std::move(next_arrival_estimator);
+    impl._pending_path_finished_callback = std::move(path_finished_callback);
+    impl._pending_flush_time = hold_until;
+    impl._sync_deadline();
+    return;
+  }
 
-  RCLCPP_INFO(adapter->node()->get_logger(), "Closing Fleet Adapter");
+  impl._discard_pending_path();
+  impl._commit_path(
+    waypoints,
+    std::move(next_arrival_estimator),
+    std::move(path_finished_callback),
+    now);
+}
 
-  rclcpp::shutdown();
+//==============================================================================
+void FullControlHandle::stop()
+{
+  const CallbackWatchdog::Scope timing(
+    _pimpl->_context->watchdog.get(), Callback::Stop, &_pimpl->_robot_name);
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  _pimpl->_discard_pending_path();
+  _pimpl->_cancel_task();
+  _pimpl->_stop_task.start(std::chrono::steady_clock::now());
+  _pimpl->_sync_deadline();
 }
+
+//==============================================================================
+void FullControlHandle::dock(
+  const std::string& dock_name,
+  RequestCompleted docking_finished_callback)
+{
+  const CallbackWatchdog::Scope timing(
+    _pimpl->_context->watchdog.get(), Callback::Dock, &_pimpl->_robot_name);
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  _pimpl->_discard_pending_path();
+  _pimpl->_docking_finished_callback = std::move(docking_finished_callback);
+  _pimpl->_dock_task.dock_name = dock_name;
+  _pimpl->_start_dock();
+}
+
+//==============================================================================
+void FullControlHandle::set_updater(
+  rmf_fleet_adapter::agv::RobotUpdateHandlePtr updater)
+{
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  _pimpl->_updater = std::move(updater);
+  // _pimpl->_start();
+}
+
+//==============================================================================
+void FullControlHandle::update_state(const messages::RobotState& new_state)
+{
+  std::unique_lock<std::mutex> lock(_pimpl->_mutex);
+  if (!_pimpl->_updater)
+    return;
+
+  _pimpl->_level_name = new_state.location.level_name;
+
+  const auto now = std::chrono::steady_clock::now();
+  _pimpl->_trip_stops.observe(
+    new_state.location.x, new_state.location.y, now);
+
+  auto& stop_task = _pimpl->_stop_task;
+  if (!stop_task.done())
+  {
+    stop_task.resume(
+      Implementation::_event_for(stop_task, new_state), &new_state, now);
+    _pimpl->_sync_deadline();
+  }
+
+  const auto handler =
+    Implementation::_state_handlers[static_cast<std::size_t>(_pimpl->_phase)];
+  ((*_pimpl).*handler)(new_state, now);
+
+  const auto completed = std::move(_pimpl->_completed);
+  _pimpl->_completed = nullptr;
+  lock.unlock();
+
+  if (completed)
+    completed();
+}
+
+//==============================================================================
+void FullControlHandle::check_timeouts(rmf_traffic::Time now)
+{
+  if (now.time_since_epoch().count() < _pimpl->_wake_time)
+    return;
+
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  if (_pimpl->_has_pending_path && _pimpl->_pending_flush_time <= now)
+    _pimpl->_flush_pending_path(now);
+
+  const TaskFrame* task = _pimpl->_active_task();
+  if (task && task->deadline() <= now)
+    _pimpl->_handle_timeout(now);
+
+  if (_pimpl->_stop_task.deadline() <= now)
+    _pimpl->_stop_task.resume(TaskEvent::Timeout, nullptr, now);
+
+  _pimpl->_sync_deadline();
+}
+
+//==============================================================================
+void FullControlHandle::set_path_debounce_window(rmf_traffic::Duration window)
+{
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  _pimpl->_debounce_window = window;
+}
+
+//==============================================================================
+uint64_t FullControlHandle::suppressed_paths() const
+{
+  return _pimpl->_suppressed_paths;
+}
+
+//==============================================================================
+std::size_t FullControlHandle::memory_bytes() const
+{
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  return sizeof(FullControlHandle) + sizeof(Implementation)
+    + _pimpl->_path_arena.capacity() + heap_bytes(_pimpl->_robot_name)
+    + heap_bytes(_pimpl->_level_name) + heap_bytes(_pimpl->_requester_id);
+}
+
+//==============================================================================
+TripStops FullControlHandle::trip_stops() const
+{
+  std::lock_guard<std::mutex> lock(_pimpl->_mutex);
+  return _pimpl->_trip_stops.totals();
+}
+
+//==============================================================================
+const FullControlHandle::Implementation::StateHandler
+FullControlHandle::Implementation::_state_handlers[] = {
+  &Implementation::_handle_idle_state,  // Idle
+  &Implementation::_handle_path_state,  // Navigating
+  &Implementation::_handle_path_state,  // Waiting
+  &Implementation::_handle_dock_state,  // Docking
+  &Implementation::_handle_idle_state   // Finished
+};
+
+//==============================================================================
+} // rmf
+} // namespace free_fleet
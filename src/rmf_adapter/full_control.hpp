@@ -26,22 +26,76 @@
 
 #include <free_fleet/transport/Middleware.hpp>
 
+#include "callback_watchdog.hpp"
+#include "command_outbox.hpp"
+#include "facility_requests.hpp"
+#include "lane_statistics.hpp"
+#include "path_simplifier.hpp"
+#include "trip_stops.hpp"
+
 namespace free_fleet {
 namespace rmf {
 
+/// Resources that every robot of a fleet shares. Each robot handle only holds
+/// a single pointer to this instead of its own copies.
+struct FleetContext
+{
+  rclcpp::Node* node;
+
+  std::string fleet_name;
+
+  std::shared_ptr<const rmf_traffic::agv::Graph> graph;
+
+  std::shared_ptr<const rmf_traffic::agv::VehicleTraits> traits;
+
+  std::shared_ptr<free_fleet::transport::Middleware> middleware;
+
+  /// Initial capacity of the arena that each robot uses for its current path
+  std::size_t path_arena_capacity = 4096;
+
+  /// How long to wait for a robot to acknowledge a command before resending
+  rmf_traffic::Duration command_ack_timeout = std::chrono::seconds(2);
+
+  /// How many times an unacknowledged command gets resent before giving up
+  std::size_t command_retries = 3;
+
+  /// Whether stop requests are resent until the robot acknowledges them, the
+  /// same way as navigation and docking requests. Otherwise they are sent
+  /// once.
+  bool reliable_stop = true;
+
+  /// Default debounce window for new paths of each robot
+  rmf_traffic::Duration path_debounce_window = rmf_traffic::Duration(0);
+
+  /// How plans get compressed before they are sent to the robots
+  PathSimplification path_simplification;
+
+  /// Learned traversal times of the lanes, which sharpen the arrival
+  /// estimates. This is null if learning is turned off.
+  std::shared_ptr<LaneStatistics> lane_statistics;
+
+  /// Gathers the commands of the robots so they get written out once per
+  /// tick. This is null if every command is sent right away.
+  std::shared_ptr<CommandOutbox> outbox;
+
+  /// Opens doors and calls lifts ahead of the robots that need them. This is
+  /// null if requests only get made once a robot has arrived.
+  std::shared_ptr<FacilityRequester> facility_requests;
+
+  /// Times the callbacks of the adapter. This is null if timing is turned
+  /// off.
+  std::shared_ptr<CallbackWatchdog> watchdog;
+};
+
 class FullControlHandle : public rmf_fleet_adapter::agv::RobotCommandHandle
 {
 public:
 
   using SharedPtr = std::shared_ptr<FullControlHandle>;
-  
+
   FullControlHandle(
-    rclcpp::Node& node,
-    std::string fleet_name,
-    std::string robot_name,
-    std::shared_ptr<const rmf_traffic::agv::Graph> graph,
-    std::shared_ptr<const rmf_traffic::agv::VehicleTraits> traits,
-    std::shared_ptr<free_fleet::transport::Middleware> free_fleet_middleware);
+    std::shared_ptr<const FleetContext> context,
+    std::string robot_name);
 
   ~FullControlHandle();
 
@@ -60,9 +114,27 @@ public:
 
   void update_state(const messages::RobotState& new_state);
 
+  /// Wake up the active command of this robot if its deadline has passed, and
+  /// transmit a held back path once its debounce window has elapsed
+  void check_timeouts(rmf_traffic::Time now);
+
+  /// Change how long new paths are held back after a path was transmitted, so
+  /// that bursts of replans only transmit their final path. A window of zero
+  /// transmits every path right away.
+  void set_path_debounce_window(rmf_traffic::Duration window);
+
+  /// Number of paths that were replaced before they were transmitted
+  uint64_t suppressed_paths() const;
+
+  /// Bytes that this robot's command handle holds, including its path arena
+  std::size_t memory_bytes() const;
+
+  /// How often this robot stopped on the way to the end of its finished paths
+  TripStops trip_stops() const;
+
   class Implementation;
 private:
-  rmf_utils::impl_ptr<Implementation> _pimpl;
+  rmf_utils::unique_impl_ptr<Implementation> _pimpl;
 };
 
 } // rmf
@@ -0,0 +1,1127 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <mutex>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include <free_fleet_cyclonedds/CycloneDDSMiddleware.hpp>
+
+#include <rmf_fleet_adapter/agv/Adapter.hpp>
+#include <rmf_fleet_adapter/agv/parse_graph.hpp>
+
+#include <rmf_traffic_ros2/Time.hpp>
+
+#include <free_fleet_ros2/msg/fleet_state_delta.hpp>
+#include <free_fleet_ros2/srv/get_fleet_snapshot.hpp>
+
+#include "callback_watchdog.hpp"
+#include "command_batch.hpp"
+#include "dds_transport.hpp"
+#include "filtered_middleware.hpp"
+#include "fleet_delta.hpp"
+#include "fleet_snapshot.hpp"
+#include "full_control.hpp"
+#include "load_param.hpp"
+#include "periodic_thread.hpp"
+#include "proximity_index.hpp"
+#include "robot_state_table.hpp"
+#include "shard_coordinator.hpp"
+#include "startup_profile.hpp"
+#include "state_validator.hpp"
+
+namespace {
+//==============================================================================
+free_fleet_ros2::msg::RobotSnapshot to_msg(
+  const free_fleet::rmf::RobotSnapshot& robot)
+{
+  free_fleet_ros2::msg::RobotSnapshot msg;
+  msg.name = robot.name;
+  msg.model = robot.model;
+  msg.level_name = robot.level_name;
+  msg.x = robot.x;
+  msg.y = robot.y;
+  msg.yaw = robot.yaw;
+  msg.mode = robot.mode;
+  msg.task_id = robot.task_id;
+  msg.battery_percent = robot.battery_percent;
+  msg.last_seen = rclcpp::Time(robot.last_seen);
+  return msg;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+struct Connections : public std::enable_shared_from_this<Connections>
+{
+  /// The API for adding new robots to the adapter
+  rmf_fleet_adapter::agv::FleetUpdateHandlePtr fleet;
+
+  /// The API for running the fleet adapter
+  rmf_fleet_adapter::agv::AdapterPtr adapter;
+
+  /// The navigation graph, vehicle traits and free fleet middleware that are
+  /// shared by every robot of the fleet
+  std::shared_ptr<free_fleet::rmf::FleetContext> context;
+
+  /// Hot per-robot data, indexed by the slot each robot was given when its
+  /// first state arrived
+  free_fleet::rmf::RobotStateTable states;
+
+  /// Finds the robots near a point, kept in step with states. This is null if
+  /// the index is turned off. Queries must hold the mutex, like ingestion.
+  std::unique_ptr<free_fleet::rmf::ProximityIndex> proximity;
+
+  /// The robot command handles, indexed the same way as states. An entry stays
+  /// null until the fleet adapter has finished registering the robot.
+  std::vector<std::shared_ptr<free_fleet::rmf::FullControlHandle>> robots;
+
+  /// Whether registration of the robot in each slot has been started
+  std::vector<uint8_t> registering;
+
+  /// Decides which robots this process handles when the fleet is split
+  /// across several adapter processes. This is null if the fleet is not
+  /// sharded.
+  std::unique_ptr<free_fleet::rmf::ShardCoordinator> shards;
+
+  /// Timer that keeps the shard membership up to date
+  std::shared_ptr<rclcpp::TimerBase> shard_timer;
+
+  /// The middleware that the fleet context reads states through, which
+  /// counts the states it discards
+  std::shared_ptr<free_fleet::rmf::FilteredMiddleware> filtered_middleware;
+
+  /// Screens incoming states before they are used. This is null if state
+  /// validation has been turned off.
+  std::unique_ptr<free_fleet::rmf::StateValidator> validator;
+
+  /// Validation results of the current drain, reused between drains
+  std::vector<uint8_t> accepted;
+
+  /// Number of states that were dropped because the state table has no room
+  /// left for their level
+  uint64_t unindexed_levels = 0;
+
+  /// Timer that polls for all the incoming states, unless a dedicated thread
+  /// does that
+  std::shared_ptr<rclcpp::TimerBase> timer;
+
+  /// Timer that writes out the commands gathered in the outbox, if commands
+  /// are batched
+  std::shared_ptr<rclcpp::TimerBase> outbox_timer;
+
+  /// Timer that periodically reports fleet-wide metrics
+  std::shared_ptr<rclcpp::TimerBase> report_timer;
+
+  /// Number of suppressed paths at the time of the last report
+  uint64_t reported_suppressed_paths = 0;
+
+  /// Number of finished trips at the time of the last report
+  uint64_t reported_trips = 0;
+
+  /// Number of filtered and superseded states at the time of the last report
+  uint64_t reported_discarded_states = 0;
+  uint64_t reported_superseded_states = 0;
+
+  /// Where the learned lane statistics are kept between runs. Empty if they
+  /// are not persisted.
+  std::string lane_statistics_file;
+
+  std::mutex mutex;
+
+  /// Immutable pictures of the fleet for readers that must not hold up
+  /// ingestion
+  free_fleet::rmf::FleetSnapshotPublisher snapshots;
+
+  /// Serves pages of the latest fleet snapshot
+  rclcpp::Service<free_fleet_ros2::srv::GetFleetSnapshot>::SharedPtr
+    snapshot_service;
+
+  /// Publishes keyframes and deltas of the fleet for UIs. These are null if
+  /// the deltas are turned off.
+  std::unique_ptr<free_fleet::rmf::FleetDeltaEncoder> delta_encoder;
+  free_fleet::rmf::FleetDeltaEncoder::Frame delta_frame;
+  rclcpp::Publisher<free_fleet_ros2::msg::FleetStateDelta>::SharedPtr
+    delta_publisher;
+  std::shared_ptr<rclcpp::TimerBase> delta_timer;
+
+  /// Runs the state ingestion when it is not left to the executor
+  std::unique_ptr<free_fleet::rmf::PeriodicThread> ingestion_thread;
+
+  /// Models of the robots in the configured roster, which get checked against
+  /// the first state of each robot
+  std::unordered_map<std::string, std::string> roster_models;
+
+  /// A robot of the configured roster
+  struct RosterEntry
+  {
+    std::string name;
+    std::string model;
+    std::string home_waypoint;
+  };
+
+  /// Roster robots whose shard was not decided yet when the roster was
+  /// preloaded. They are preloaded again once the shards have settled.
+  std::vector<RosterEntry> deferred_roster;
+
+  /// Write the learned lane statistics to their file if anything was learned
+  /// since they were last written
+  void save_lane_statistics()
+  {
+    const auto& stats = context->lane_statistics;
+    if (!stats || lane_statistics_file.empty() || !stats->dirty())
+      return;
+
+    if (!stats->save(lane_statistics_file, context->graph->num_waypoints()))
+    {
+      RCLCPP_ERROR(
+        adapter->node()->get_logger(),
+        "Failed to save the lane statistics to [%s]",
+        lane_statistics_file.c_str());
+    }
+  }
+
+  /// Get the slot of a robot, setting up its entries in every per-robot table
+  /// if the robot is new
+  std::size_t slot_for(const std::string& robot_name)
+  {
+    const auto insertion = states.insert(robot_name);
+    if (insertion.second)
+    {
+      robots.push_back(nullptr);
+      registering.push_back(false);
+    }
+
+    return insertion.first;
+  }
+
+  void add_robot(
+    std::size_t slot,
+    const free_fleet::messages::RobotState& state)
+  {
+    const free_fleet::rmf::CallbackWatchdog::Scope timing(
+      context->watchdog.get(), free_fleet::rmf::Callback::Registration,
+      &state.name);
+    const auto& loc = state.location;
+    register_robot(
+      slot,
+      state.name,
+      rmf_traffic::agv::compute_plan_starts(
+        *context->graph,
+        loc.level_name,
+        {loc.x, loc.y, loc.yaw},
+        rmf_traffic_ros2::convert(adapter->node()->now())));
+  }
+
+  void register_robot(
+    std::size_t slot,
+    const std::string& robot_name,
+    std::vector<rmf_traffic::agv::Plan::Start> starts)
+  {
+    registering[slot] = true;
+    const auto command = std::make_shared<free_fleet::rmf::FullControlHandle>(
+      context,
+      robot_name);
+
+    fleet->add_robot(
+      command,
+      robot_name,
+      context->traits->profile(),
+      std::move(starts),
+      [c = weak_from_this(), command, slot, robot_name](
+        const rmf_fleet_adapter::agv::RobotUpdateHandlePtr& updater)
+    {
+      const auto connections = c.lock();
+      if (!connections)
+        return;
+
+      const free_fleet::rmf::CallbackWatchdog::Scope timing(
+        connections->context->watchdog.get(),
+        free_fleet::rmf::Callback::Registered, &robot_name);
+      std::lock_guard<std::mutex> lock(connections->mutex);
+
+      command->set_updater(updater);
+      connections->robots[slot] = command;
+    });
+  }
+
+  /// Register the robots that are known up front at their home waypoints, so
+  /// that they can be given tasks before their first state arrives. Robots
+  /// without a home waypoint only get their table entries set up. Robots whose
+  /// shard is not decided yet are deferred.
+  void preload_roster(const std::vector<RosterEntry>& roster)
+  {
+    const auto& logger = adapter->node()->get_logger();
+    const auto now = rmf_traffic_ros2::convert(adapter->node()->now());
+    const auto& keys = context->graph->keys();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    states.reserve(states.size() + roster.size());
+    robots.reserve(robots.size() + roster.size());
+    registering.reserve(registering.size() + roster.size());
+    std::size_t preloaded = 0;
+    for (const auto& entry : roster)
+    {
+      const auto& name = entry.name;
+      if (!entry.model.empty())
+        roster_models[name] = entry.model;
+
+      if (shards)
+      {
+        const auto owner =
+          shards->owner(name, std::chrono::steady_clock::now());
+        if (!owner)
+        {
+          deferred_roster.push_back(entry);
+          continue;
+        }
+
+        if (*owner != shards->shard_id())
+          continue;
+      }
+
+      const std::size_t slot = slot_for(name);
+      // A deferred robot may have registered from its own state by now
+      if (entry.home_waypoint.empty() || registering[slot])
+        continue;
+
+      const auto key = keys.find(entry.home_waypoint);
+      if (key == keys.end())
+      {
+        RCLCPP_ERROR(
+          logger,
+          "Home waypoint [%s] of robot [%s] is not in the navigation graph",
+          entry.home_waypoint.c_str(), name.c_str());
+        continue;
+      }
+
+      register_robot(
+        slot, name, {rmf_traffic::agv::Plan::Start(now, key->second, 0.0)});
+      ++preloaded;
+    }
+
+    RCLCPP_INFO(
+      logger, "Preloaded %zu of %zu robots from the roster at their home "
+      "waypoints", preloaded, roster.size());
+
+    if (!deferred_roster.empty())
+    {
+      RCLCPP_INFO(
+        logger, "Deferred %zu roster robots until the shards have settled",
+        deferred_roster.size());
+    }
+  }
+
+  /// Drain the incoming states, pass them on to the robots, and wake up the
+  /// robots whose commands have timed out
+  void ingest()
+  {
+    // The shard filter inside the middleware needs the lock, so the states
+    // are read while holding it.
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto new_states = context->middleware->read_states();
+    const int64_t now = adapter->node()->now().nanoseconds();
+
+    if (validator)
+      validator->validate(new_states, accepted);
+
+    for (std::size_t i = 0; i < new_states.size(); ++i)
+    {
+      const auto& state = new_states[i];
+      // A robot only gets a slot once one of its states passes every check,
+      // so that states under names which never make it through cannot fill
+      // the per-robot tables.
+      const auto known = states.find(state.name);
+
+      if (validator && !accepted[i])
+      {
+        // Only report the first rejection of a robot and then every
+        // hundredth one, so a misbehaving robot cannot flood the log. Robots
+        // without a slot have nothing but rejections, so they are throttled
+        // by the fleet total instead.
+        const auto* record =
+          known ? &validator->record(*known, false) : nullptr;
+        const uint64_t rejected =
+          record ? record->rejected : validator->quarantined();
+        if (rejected % 100 == 1)
+        {
+          RCLCPP_WARN(
+            adapter->node()->get_logger(),
+            "Quarantined state of robot [%.64s] at (%f, %f, %f) on level "
+            "[%.64s]. %.1f%% of its states have been rejected, %lu in total "
+            "for the fleet.", state.name.c_str(), state.location.x,
+            state.location.y, state.location.yaw,
+            state.location.level_name.c_str(),
+            record ? 100.0 * record->rejection_rate() : 100.0,
+            static_cast<unsigned long>(validator->quarantined()));
+        }
+        continue;
+      }
+
+      if (states.level_id(state.location.level_name)
+        == free_fleet::rmf::RobotStateTable::NoLevel)
+      {
+        if (++unindexed_levels % 100 == 1)
+        {
+          RCLCPP_WARN(
+            adapter->node()->get_logger(),
+            "Dropped a state of robot [%.64s] on level [%.64s], the state "
+            "table already holds the most levels it can, %lu dropped in total",
+            state.name.c_str(), state.location.level_name.c_str(),
+            static_cast<unsigned long>(unindexed_levels));
+        }
+        continue;
+      }
+
+      const std::size_t slot = known ? *known : slot_for(state.name);
+      if (validator)
+        validator->record(slot, true);
+
+      if (states.last_seen[slot] == 0 && !roster_models.empty())
+      {
+        const auto model = roster_models.find(state.name);
+        if (model != roster_models.end() && model->second != state.model)
+        {
+          RCLCPP_WARN(
+            adapter->node()->get_logger(),
+            "Robot [%s] reports model [%s] but the roster expects [%s]",
+            state.name.c_str(), state.model.c_str(), model->second.c_str());
+        }
+      }
+
+      // The level was checked above, so the update always succeeds.
+      states.update(slot, state, now);
+      snapshots.update(slot, state);
+      if (proximity)
+        proximity->update(states, slot);
+
+      const auto& command = robots[slot];
+      if (command)
+      {
+        command->update_state(state);
+        continue;
+      }
+
+      if (!registering[slot])
+        add_robot(slot, state);
+    }
+
+    snapshots.publish(states, now);
+
+    const auto steady_now = std::chrono::steady_clock::now();
+    for (const auto& command : robots)
+    {
+      if (command)
+        command->check_timeouts(steady_now);
+    }
+  }
+};
+
+//==============================================================================
+std::shared_ptr<Connections> make_fleet(
+  const rmf_fleet_adapter::agv::AdapterPtr& adapter)
+{
+  free_fleet::rmf::StartupProfile startup;
+  const auto& node = adapter->node();
+  std::shared_ptr<Connections> connections = std::make_shared<Connections>();
+  connections->adapter = adapter;
+
+  const std::string dds_domain_id_param_name = "dds_domain";
+  const int dds_domain = node->declare_parameter(
+    dds_domain_id_param_name, -1);
+  if (dds_domain == -1)
+  {
+    RCLCPP_ERROR(
+      node->get_logger(),
+      "Missing [%s] parameter", dds_domain_id_param_name.c_str());
+    return nullptr;
+  }
+
+  const std::string fleet_name_param_name = "fleet_name";
+  const std::string fleet_name = node->declare_parameter(
+    fleet_name_param_name, std::string());
+  if (fleet_name.empty())
+  {
+    RCLCPP_ERROR(
+      node->get_logger(),
+      "Missing [%s] parameter", fleet_name_param_name.c_str());
+    return nullptr;
+  }
+
+  connections->context = std::make_shared<free_fleet::rmf::FleetContext>();
+  connections->context->node = node.get();
+  connections->context->fleet_name = fleet_name;
+
+  connections->context->traits =
+    std::make_shared<rmf_traffic::agv::VehicleTraits>(
+      free_fleet::rmf::get_traits_or_default(
+        *node, 0.7, 0.3, 0.5, 1.5, 0.5, 1.5));
+
+  const std::string nav_graph_param_name = "nav_graph_file";
+  const std::string graph_file =
+    node->declare_parameter(nav_graph_param_name, std::string());
+  if (graph_file.empty())
+  {
+    RCLCPP_ERROR(
+      node->get_logger(),
+      "Missing [%s] parameter", nav_graph_param_name.c_str());
+    return nullptr;
+  }
+  startup.mark("parameters");
+
+  const auto graph =
+    std::make_shared<rmf_traffic::agv::Graph>(
+      rmf_fleet_adapter::agv::parse_graph(
+        graph_file, *connections->context->traits));
+  connections->context->graph = graph;
+  startup.mark("parse_graph");
+
+  free_fleet::rmf::print_waypoint_names(std::cout, fleet_name, *graph);
+  startup.mark("print_waypoints");
+
+  connections->fleet = adapter->add_fleet(
+    fleet_name, *connections->context->traits, *graph);
+  startup.mark("add_fleet");
+
+  // If the perform_deliveries parameter is true, then we just blindly accept
+  // all delivery requests.
+  if (node->declare_parameter<bool>("perform_deliveries", false))
+  {
+    connections->fleet->accept_delivery_requests(
+      [](const rmf_task_msgs::msg::Delivery&){ return true; });
+  }
+
+  if (node->declare_parameter<bool>("disable_delay_threshold", false))
+  {
+    connections->fleet->default_maximum_delay(rmf_utils::nullopt);
+  }
+  else
+  {
+    connections->fleet->default_maximum_delay(
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "delay_threshold", 10.0));
+  }
+
+  if (node->declare_parameter<bool>("learn_lane_times", true))
+  {
+    const auto stats = std::make_shared<free_fleet::rmf::LaneStatistics>(
+      free_fleet::rmf::get_parameter_or_default(
+        *node, "lane_statistics_alpha", 0.2),
+      static_cast<uint64_t>(free_fleet::rmf::get_parameter_or_default(
+        *node, "lane_statistics_min_samples", 3)),
+      free_fleet::rmf::get_parameter_or_default(
+        *node, "lane_statistics_max_deviation", 0.5));
+
+    connections->lane_statistics_file =
+      node->declare_parameter("lane_statistics_file", std::string());
+    const auto& file = connections->lane_statistics_file;
+    if (!file.empty())
+    {
+      if (stats->load(file, graph->num_waypoints()))
+      {
+        RCLCPP_INFO(
+          node->get_logger(), "Loaded statistics of %zu lanes from [%s]",
+          stats->size(), file.c_str());
+      }
+      else
+      {
+        RCLCPP_WARN(
+          node->get_logger(),
+          "No usable lane statistics in [%s], learning from scratch",
+          file.c_str());
+      }
+    }
+
+    connections->context->lane_statistics = stats;
+  }
+
+  // In the memory budget mode the per-robot path arenas start small and only
+  // grow for robots that actually receive long paths.
+  if (node->declare_parameter<bool>("compact_robot_state", false))
+    connections->context->path_arena_capacity = 256;
+
+  // Nothing in the adapter queries the proximity index itself, so it is only
+  // kept up to date when an extension that looks up nearby robots asks for it.
+  if (node->declare_parameter<bool>("proximity_index", false))
+  {
+    double cell_size = free_fleet::rmf::get_parameter_or_default(
+      *node, "proximity_cell_size", 2.0);
+    if (!(cell_size > 0.0))
+    {
+      RCLCPP_WARN(
+        node->get_logger(),
+        "Parameter [proximity_cell_size] must be positive. Using 2.0 instead.");
+      cell_size = 2.0;
+    }
+
+    connections->proximity =
+      std::make_unique<free_fleet::rmf::ProximityIndex>(cell_size);
+  }
+
+  if (node->declare_parameter<bool>("lookahead_facility_requests", true))
+  {
+    connections->context->facility_requests =
+      std::make_shared<free_fleet::rmf::FacilityRequester>(
+      *node,
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "facility_request_lead_time", 10.0));
+  }
+
+  const int expected_fleet_size =
+    node->declare_parameter("expected_fleet_size", 0);
+  if (expected_fleet_size > 0)
+  {
+    connections->states.reserve(expected_fleet_size);
+    connections->robots.reserve(expected_fleet_size);
+    connections->registering.reserve(expected_fleet_size);
+  }
+
+  connections->context->command_ack_timeout =
+    free_fleet::rmf::get_parameter_or_default_time(
+      *node, "command_ack_timeout", 2.0);
+  connections->context->command_retries =
+    free_fleet::rmf::get_parameter_or_default(*node, "command_retries", 3);
+  connections->context->reliable_stop =
+    node->declare_parameter<bool>("reliable_stop", true);
+  connections->context->path_debounce_window =
+    free_fleet::rmf::get_parameter_or_default_time(
+      *node, "path_debounce_window", 0.0);
+
+  auto& simplification = connections->context->path_simplification;
+  simplification.enabled =
+    node->declare_parameter<bool>("simplify_paths", true);
+  simplification.collinear_tolerance =
+    free_fleet::rmf::get_parameter_or_default(
+      *node, "simplify_paths_collinear_tolerance", 0.05);
+  simplification.yaw_tolerance =
+    free_fleet::rmf::get_parameter_or_default(
+      *node, "simplify_paths_yaw_tolerance", 0.05);
+  simplification.timing_tolerance =
+    free_fleet::rmf::get_parameter_or_default(
+      *node, "simplify_paths_timing_tolerance", 0.5);
+
+  if (node->declare_parameter<bool>("callback_watchdog", true))
+  {
+    using free_fleet::rmf::Callback;
+    auto watchdog = std::make_shared<free_fleet::rmf::CallbackWatchdog>(
+      node->get_logger());
+
+    watchdog->set_budget(
+      Callback::Ingest,
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "callback_budget_ingest", 0.05));
+
+    const auto registration_budget =
+      free_fleet::rmf::get_parameter_or_default_time(
+      *node, "callback_budget_registration", 0.1);
+    watchdog->set_budget(Callback::Registration, registration_budget);
+    watchdog->set_budget(Callback::Registered, registration_budget);
+
+    const auto command_budget =
+      free_fleet::rmf::get_parameter_or_default_time(
+      *node, "callback_budget_command", 0.01);
+    watchdog->set_budget(Callback::FollowPath, command_budget);
+    watchdog->set_budget(Callback::Stop, command_budget);
+    watchdog->set_budget(Callback::Dock, command_budget);
+
+    const auto background_budget =
+      free_fleet::rmf::get_parameter_or_default_time(
+      *node, "callback_budget_background", 0.02);
+    watchdog->set_budget(Callback::SnapshotService, background_budget);
+    watchdog->set_budget(Callback::DeltaPublish, background_budget);
+    watchdog->set_budget(Callback::OutboxFlush, background_budget);
+    watchdog->set_budget(Callback::ShardRefresh, background_budget);
+
+    connections->context->watchdog = std::move(watchdog);
+  }
+
+  RCLCPP_INFO(
+    node->get_logger(),
+    "Each robot uses %zu bytes of hot state arrays and starts with a %zu byte "
+    "path arena. The full footprint is part of the periodic report.",
+    free_fleet::rmf::RobotStateTable::bytes_per_robot(),
+    connections->context->path_arena_capacity);
+
+  if (node->declare_parameter<bool>("validate_states", true))
+  {
+    connections->validator =
+      std::make_unique<free_fleet::rmf::StateValidator>(
+        *graph,
+        free_fleet::rmf::get_parameter_or_default(
+          *node, "state_bounds_margin", 10.0));
+  }
+
+  const int shard_id = node->declare_parameter("shard_id", -1);
+  if (shard_id >= 0)
+  {
+    connections->shards = std::make_unique<free_fleet::rmf::ShardCoordinator>(
+      *node, fleet_name, static_cast<uint32_t>(shard_id),
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "shard_settle_time", 5.0));
+
+    connections->shard_timer =
+      node->create_wall_timer(
+      std::chrono::seconds(1),
+      [c = std::weak_ptr<Connections>(connections)]()
+    {
+      const auto connections = c.lock();
+      if (!connections)
+        return;
+
+      const free_fleet::rmf::CallbackWatchdog::Scope timing(
+        connections->context->watchdog.get(),
+        free_fleet::rmf::Callback::ShardRefresh);
+
+      std::vector<Connections::RosterEntry> deferred;
+      {
+        std::lock_guard<std::mutex> lock(connections->mutex);
+        if (connections->shards->refresh())
+        {
+          std::string members;
+          for (const auto id : connections->shards->members())
+            members += " " + std::to_string(id);
+
+          RCLCPP_INFO(
+            connections->adapter->node()->get_logger(),
+            "Shard membership changed, live shards:%s", members.c_str());
+        }
+
+        if (connections->shards->settled(std::chrono::steady_clock::now()))
+          deferred.swap(connections->deferred_roster);
+      }
+
+      if (!deferred.empty())
+        connections->preload_roster(deferred);
+    });
+  }
+
+  // States that this adapter has no use for are discarded as soon as they are
+  // read from the middleware.
+  free_fleet::rmf::StateFilter state_filter;
+  for (const auto& name : node->declare_parameter(
+      "state_filter_robot_names", std::vector<std::string>()))
+    state_filter.robot_names.insert(name);
+
+  for (const auto& level : node->declare_parameter(
+      "state_filter_levels", std::vector<std::string>()))
+    state_filter.levels.insert(level);
+
+  // Only the newest state of each robot is worth processing. This is the
+  // keep-last history that the state stream should have, applied on the
+  // adapter side since the server's readers are not configurable.
+  state_filter.history_depth = static_cast<std::size_t>(
+    free_fleet::rmf::get_parameter_or_default(
+      *node, "state_history_depth", 1));
+
+  if (auto* shards = connections->shards.get())
+  {
+    // Robots that belong to other shards, or whose shard is not decided yet,
+    // are dropped before any other work is spent on them.
+    state_filter.predicate =
+      [shards](const free_fleet::messages::RobotState& state)
+      {
+        return shards->owns(state.name, std::chrono::steady_clock::now());
+      };
+  }
+
+  // The transport has to be configured before the server creates its DDS
+  // participant.
+  const auto dds_transport_name =
+    node->declare_parameter<std::string>("dds_transport", "default");
+  const auto dds_transport =
+    free_fleet::rmf::parse_dds_transport(dds_transport_name);
+  if (!dds_transport)
+  {
+    RCLCPP_ERROR(
+      node->get_logger(),
+      "Unknown dds_transport [%s], expected default, loopback or shm",
+      dds_transport_name.c_str());
+    return nullptr;
+  }
+  free_fleet::rmf::configure_dds_transport(
+    *dds_transport, dds_domain, node->get_logger());
+  startup.mark("fleet_configuration");
+
+  connections->filtered_middleware =
+    std::make_shared<free_fleet::rmf::FilteredMiddleware>(
+    free_fleet::cyclonedds::CycloneDDSMiddleware::make_server(
+      dds_domain, fleet_name),
+    std::move(state_filter));
+  connections->context->middleware = connections->filtered_middleware;
+  startup.mark("make_server");
+
+  // With a dedicated ingestion thread, commands are published from that
+  // thread as well, so neither side of the robot traffic waits on the
+  // executor.
+  const bool ingestion_thread =
+    node->declare_parameter<bool>("ingestion_thread", false);
+  const auto ingestion_period = std::chrono::nanoseconds(
+    std::chrono::milliseconds(100));
+  auto command_batch_period = ingestion_period;
+
+  // The outbox has to exist before the first robot handle gets created.
+  if (node->declare_parameter<bool>("batch_commands", false))
+  {
+    // With batch publishing, robots receive their commands by picking out
+    // their entries of the batch topic instead of through the middleware.
+    std::shared_ptr<free_fleet::rmf::CommandBatchSink> batch_sink;
+    if (node->declare_parameter<bool>("publish_command_batches", false))
+    {
+      batch_sink = std::make_shared<free_fleet::rmf::CommandBatchPublisher>(
+        *node, node->declare_parameter(
+          "command_batch_topic", fleet_name + "/command_batch"));
+    }
+
+    const auto outbox = std::make_shared<free_fleet::rmf::CommandOutbox>(
+      connections->context->middleware, std::move(batch_sink));
+    connections->context->outbox = outbox;
+    command_batch_period =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "command_batch_period", 0.02));
+
+    if (!ingestion_thread)
+    {
+      connections->outbox_timer =
+        node->create_wall_timer(
+        command_batch_period,
+        [outbox, watchdog = connections->context->watchdog]()
+        {
+          const free_fleet::rmf::CallbackWatchdog::Scope timing(
+            watchdog.get(), free_fleet::rmf::Callback::OutboxFlush);
+          outbox->flush();
+        });
+    }
+  }
+
+  {
+    const auto names =
+      node->declare_parameter("roster_names", std::vector<std::string>());
+    const auto models =
+      node->declare_parameter("roster_models", std::vector<std::string>());
+    const auto home_waypoints = node->declare_parameter(
+      "roster_home_waypoints", std::vector<std::string>());
+
+    std::vector<Connections::RosterEntry> roster;
+    roster.reserve(names.size());
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+      roster.push_back(
+        {
+          names[i],
+          i < models.size() ? models[i] : std::string(),
+          i < home_waypoints.size() ? home_waypoints[i] : std::string()
+        });
+    }
+
+    connections->preload_roster(roster);
+  }
+  startup.mark("preload_roster");
+
+  if (node->declare_parameter<bool>("snapshot_service", true))
+  {
+    using GetFleetSnapshot = free_fleet_ros2::srv::GetFleetSnapshot;
+    connections->snapshot_service = node->create_service<GetFleetSnapshot>(
+      "~/fleet_snapshot",
+      [c = std::weak_ptr<Connections>(connections)](
+        const std::shared_ptr<GetFleetSnapshot::Request> request,
+        std::shared_ptr<GetFleetSnapshot::Response> response)
+      {
+        const auto connections = c.lock();
+        if (!connections)
+          return;
+
+        const free_fleet::rmf::CallbackWatchdog::Scope timing(
+          connections->context->watchdog.get(),
+          free_fleet::rmf::Callback::SnapshotService);
+
+        // The snapshot is immutable, so the response can be filled without
+        // holding up ingestion.
+        const auto snapshot = connections->snapshots.latest();
+        const auto page = snapshot->page(
+          request->level_name, request->offset, request->limit);
+
+        response->version = snapshot->version();
+        response->stamp = rclcpp::Time(snapshot->stamp());
+        response->total = static_cast<uint32_t>(page.total);
+        response->robots.reserve(page.robots.size());
+        for (const auto* robot : page.robots)
+          response->robots.push_back(to_msg(*robot));
+      });
+  }
+
+  if (node->declare_parameter<bool>("publish_fleet_deltas", true))
+  {
+    free_fleet::rmf::DeltaThresholds thresholds;
+    thresholds.position = free_fleet::rmf::get_parameter_or_default(
+      *node, "fleet_delta_position_threshold", 0.05);
+    thresholds.yaw = free_fleet::rmf::get_parameter_or_default(
+      *node, "fleet_delta_yaw_threshold", 0.05);
+
+    connections->delta_encoder =
+      std::make_unique<free_fleet::rmf::FleetDeltaEncoder>(
+      thresholds,
+      free_fleet::rmf::get_parameter_or_default_time(
+        *node, "fleet_delta_keyframe_period", 5.0).count());
+
+    connections->delta_publisher =
+      node->create_publisher<free_fleet_ros2::msg::FleetStateDelta>(
+      "~/fleet_state_delta", rclcpp::QoS(10).reliable());
+
+    // Deltas are worked out from the snapshots, so the encoder never has to
+    // take the ingestion lock.
+    connections->delta_timer =
+      node->create_wall_timer(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        free_fleet::rmf::get_parameter_or_default_time(
+          *node, "fleet_delta_period", 0.2)),
+      [c = std::weak_ptr<Connections>(connections)]()
+    {
+      const auto connections = c.lock();
+      if (!connections)
+        return;
+
+      const free_fleet::rmf::CallbackWatchdog::Scope timing(
+        connections->context->watchdog.get(),
+        free_fleet::rmf::Callback::DeltaPublish);
+
+      const auto snapshot = connections->snapshots.latest();
+      auto& frame = connections->delta_frame;
+      if (!connections->delta_encoder->encode(
+          *snapshot, connections->adapter->node()->now().nanoseconds(),
+          frame))
+        return;
+
+      free_fleet_ros2::msg::FleetStateDelta msg;
+      msg.sequence = frame.sequence;
+      msg.keyframe = frame.keyframe;
+      msg.keyframe_sequence = frame.keyframe_sequence;
+      msg.stamp = rclcpp::Time(frame.stamp);
+      msg.robots.reserve(frame.robots.size());
+      for (const auto* robot : frame.robots)
+        msg.robots.push_back(to_msg(*robot));
+
+      connections->delta_publisher->publish(msg);
+    });
+  }
+
+  // Ingestion either runs on the executor or on a thread of its own, which
+  // can be pinned to cores that the planners do not use.
+  const auto ingest =
+    [c = std::weak_ptr<Connections>(connections)]()
+    {
+      const auto connections = c.lock();
+      if (!connections)
+        return;
+
+      const free_fleet::rmf::CallbackWatchdog::Scope timing(
+        connections->context->watchdog.get(),
+        free_fleet::rmf::Callback::Ingest);
+      connections->ingest();
+    };
+
+  if (ingestion_thread)
+  {
+    free_fleet::rmf::ThreadSettings settings;
+    for (const auto cpu : node->declare_parameter(
+        "ingestion_thread_cpus", std::vector<int64_t>()))
+      settings.cpus.push_back(static_cast<int>(cpu));
+    settings.priority =
+      node->declare_parameter<int>("ingestion_thread_priority", 0);
+
+    // The thread wakes up for every command batch and ingests states at
+    // their own, usually slower, period.
+    auto next_ingest = std::chrono::steady_clock::now();
+    const auto outbox = connections->context->outbox;
+    connections->ingestion_thread =
+      std::make_unique<free_fleet::rmf::PeriodicThread>(
+      "ingestion", std::min(ingestion_period, command_batch_period),
+      [ingest, ingestion_period, next_ingest, outbox,
+      watchdog = connections->context->watchdog]() mutable
+      {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= next_ingest)
+        {
+          next_ingest = now + ingestion_period;
+          ingest();
+        }
+
+        if (outbox)
+        {
+          const free_fleet::rmf::CallbackWatchdog::Scope timing(
+            watchdog.get(), free_fleet::rmf::Callback::OutboxFlush);
+          outbox->flush();
+        }
+      },
+      std::move(settings), node->get_logger());
+  }
+  else
+  {
+    connections->timer = node->create_wall_timer(ingestion_period, ingest);
+  }
+
+  connections->report_timer =
+    node->create_wall_timer(
+    std::chrono::seconds(30),
+    [c = std::weak_ptr<Connections>(connections)]()
+  {
+    const auto connections = c.lock();
+    if (!connections)
+      return;
+
+    connections->save_lane_statistics();
+
+    if (const auto& watchdog = connections->context->watchdog)
+    {
+      for (const auto& summary : watchdog->collect())
+      {
+        const auto ms = [](free_fleet::rmf::CallbackWatchdog::Duration d)
+          {
+            return std::chrono::duration<double, std::milli>(d).count();
+          };
+
+        RCLCPP_INFO(
+          connections->adapter->node()->get_logger(),
+          "Callback timing: callback=%s count=%lu p50_ms=%.3f p99_ms=%.3f "
+          "max_ms=%.3f over_budget=%lu",
+          free_fleet::rmf::CallbackWatchdog::name(summary.callback),
+          static_cast<unsigned long>(summary.count), ms(summary.p50),
+          ms(summary.p99), ms(summary.max),
+          static_cast<unsigned long>(summary.over_budget));
+      }
+    }
+
+    if (const auto& outbox = connections->context->outbox)
+    {
+      RCLCPP_INFO(
+        connections->adapter->node()->get_logger(),
+        "Sent %lu commands in %lu batches",
+        static_cast<unsigned long>(outbox->commands()),
+        static_cast<unsigned long>(outbox->flushes()));
+    }
+
+    if (const auto& middleware = connections->filtered_middleware)
+    {
+      const uint64_t discarded = middleware->discarded();
+      const uint64_t superseded = middleware->superseded();
+      if (discarded != connections->reported_discarded_states
+        || superseded != connections->reported_superseded_states)
+      {
+        RCLCPP_INFO(
+          connections->adapter->node()->get_logger(),
+          "Dropped %lu filtered and %lu superseded states, %lu and %lu since "
+          "the last report",
+          static_cast<unsigned long>(discarded),
+          static_cast<unsigned long>(superseded),
+          static_cast<unsigned long>(
+            discarded - connections->reported_discarded_states),
+          static_cast<unsigned long>(
+            superseded - connections->reported_superseded_states));
+        connections->reported_discarded_states = discarded;
+        connections->reported_superseded_states = superseded;
+      }
+    }
+
+    uint64_t suppressed = 0;
+    free_fleet::rmf::TripStops trips;
+    {
+      std::lock_guard<std::mutex> lock(connections->mutex);
+      std::size_t handle_bytes = 0;
+      for (const auto& command : connections->robots)
+      {
+        if (!command)
+          continue;
+
+        suppressed += command->suppressed_paths();
+        handle_bytes += command->memory_bytes();
+        trips += command->trip_stops();
+      }
+
+      const std::size_t count = connections->states.size();
+      if (count > 0)
+      {
+        const std::size_t table_bytes = connections->states.memory_bytes();
+        const std::size_t snapshot_bytes =
+          connections->snapshots.memory_bytes();
+        RCLCPP_INFO(
+          connections->adapter->node()->get_logger(),
+          "Memory per robot over %zu robots: state table %zu, snapshots %zu, "
+          "command handles %zu, total %zu bytes", count, table_bytes / count,
+          snapshot_bytes / count, handle_bytes / count,
+          (table_bytes + snapshot_bytes + handle_bytes) / count);
+      }
+    }
+
+    if (trips.trips != connections->reported_trips)
+    {
+      RCLCPP_INFO(
+        connections->adapter->node()->get_logger(),
+        "Robots stopped on their way %.2f times per trip over %lu trips, at "
+        "most %u times in one trip",
+        trips.stops_per_trip(), static_cast<unsigned long>(trips.trips),
+        trips.max_stops);
+      connections->reported_trips = trips.trips;
+    }
+
+    if (suppressed == connections->reported_suppressed_paths)
+      return;
+
+    RCLCPP_INFO(
+      connections->adapter->node()->get_logger(),
+      "Suppressed %lu paths during replan bursts, %lu since the last report",
+      static_cast<unsigned long>(suppressed),
+      static_cast<unsigned long>(
+        suppressed - connections->reported_suppressed_paths));
+    connections->reported_suppressed_paths = suppressed;
+  });
+  startup.mark("timers");
+
+  RCLCPP_INFO(
+    node->get_logger(),
+    "Fleet [%s] started up with %zu waypoints:%s", fleet_name.c_str(),
+    graph->num_waypoints(), startup.report().c_str());
+
+  return connections;
+}
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  rclcpp::init(argc, argv);
+  const auto adapter = rmf_fleet_adapter::agv::Adapter::make("fleet_adapter");
+  if (!adapter)
+    return 1;
+
+  const auto fleet_connections = make_fleet(adapter);
+  if (!fleet_connections)
+    return 1;
+  
+  RCLCPP_INFO(adapter->node()->get_logger(), "Starting Fleet Adapter");
+
+  // Start running the adapter and wait until it gets stopped by SIGINT
+  adapter->start().wait();
+
+  // Stop ingesting here, so that the ingestion thread is never the one that
+  // releases the last reference to the connections.
+  fleet_connections->ingestion_thread.reset();
+  fleet_connections->save_lane_statistics();
+
+  RCLCPP_INFO(adapter->node()->get_logger(), "Closing Fleet Adapter");
+
+  rclcpp::shutdown();
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstdio>
+#include <fstream>
+
+#include "lane_statistics.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+const char* const FileHeader = "# free_fleet lane statistics v1";
+
+} // anonymous namespace
+
+//==============================================================================
+LaneStatistics::LaneStatistics(
+  double alpha,
+  uint64_t min_samples,
+  double max_deviation)
+: _alpha(alpha),
+  _min_samples(min_samples),
+  _max_variance(max_deviation * max_deviation)
+{}
+
+//==============================================================================
+void LaneStatistics::observe(
+  std::size_t from_wp,
+  std::size_t to_wp,
+  double ratio)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _observe(from_wp, to_wp, ratio);
+}
+
+//==============================================================================
+void LaneStatistics::observe(
+  const std::vector<Traversal>& lanes,
+  double observed)
+{
+  double nominal = 0.0;
+  for (const auto& lane : lanes)
+    nominal += lane.nominal;
+
+  if (nominal <= 0.0)
+    return;
+
+  // Spreading the time in proportion to the nominal times gives every lane
+  // of the run the same ratio
+  const double ratio = observed / nominal;
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto& lane : lanes)
+    _observe(lane.from_wp, lane.to_wp, ratio);
+}
+
+//==============================================================================
+double LaneStatistics::ratio(std::size_t from_wp, std::size_t to_wp) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _ratio(from_wp, to_wp);
+}
+
+//==============================================================================
+double LaneStatistics::ratio(const std::vector<Traversal>& lanes) const
+{
+  double nominal = 0.0;
+  double expected = 0.0;
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto& lane : lanes)
+  {
+    nominal += lane.nominal;
+    expected += lane.nominal * _ratio(lane.from_wp, lane.to_wp);
+  }
+
+  return nominal > 0.0 ? expected / nominal : 1.0;
+}
+
+//==============================================================================
+void LaneStatistics::_observe(
+  std::size_t from_wp,
+  std::size_t to_wp,
+  double ratio)
+{
+  auto& entry = _entries[_key(from_wp, to_wp)];
+  if (entry.count == 0)
+  {
+    entry.mean = ratio;
+    entry.variance = 0.0;
+  }
+  else
+  {
+    // Incremental form of the exponentially weighted mean and variance
+    const double diff = ratio - entry.mean;
+    const double increment = _alpha * diff;
+    entry.mean += increment;
+    entry.variance = (1.0 - _alpha) * (entry.variance + diff * increment);
+  }
+
+  ++entry.count;
+  _dirty = true;
+}
+
+//==============================================================================
+auto LaneStatistics::entry(
+  std::size_t from_wp,
+  std::size_t to_wp) const -> rmf_utils::optional<Entry>
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  const auto it = _entries.find(_key(from_wp, to_wp));
+  if (it == _entries.end())
+    return rmf_utils::nullopt;
+
+  return it->second;
+}
+
+//==============================================================================
+bool LaneStatistics::load(const std::string& path, std::size_t num_waypoints)
+{
+  std::ifstream file(path);
+  if (!file)
+    return false;
+
+  std::string header;
+  std::getline(file, header);
+  std::string label;
+  std::size_t waypoints = 0;
+  if (header != FileHeader || !(file >> label >> waypoints)
+    || label != "waypoints" || waypoints != num_waypoints)
+    return false;
+
+  std::unordered_map<uint64_t, Entry> entries;
+  std::size_t from = 0;
+  std::size_t to = 0;
+  Entry entry;
+  while (file >> from >> to >> entry.count >> entry.mean >> entry.variance)
+  {
+    if (from >= num_waypoints || to >= num_waypoints)
+      return false;
+
+    entries[_key(from, to)] = entry;
+  }
+
+  if (!file.eof())
+    return false;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries = std::move(entries);
+  _dirty = false;
+  return true;
+}
+
+//==============================================================================
+bool LaneStatistics::save(
+  const std::string& path,
+  std::size_t num_waypoints) const
+{
+  std::unordered_map<uint64_t, Entry> entries;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    entries = _entries;
+    _dirty = false;
+  }
+
+  // Writing to a temporary file first means that a crash while saving never
+  // leaves a truncated file behind.
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    file << FileHeader << "\nwaypoints " << num_waypoints << "\n";
+    file.precision(17);
+    for (const auto& e : entries)
+    {
+      file << (e.first >> 32) << " " << (e.first & 0xFFFFFFFF) << " "
+           << e.second.count << " " << e.second.mean << " "
+           << e.second.variance << "\n";
+    }
+
+    if (!file.flush())
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _dirty = true;
+      return false;
+    }
+  }
+
+  if (std::rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _dirty = true;
+    return false;
+  }
+
+  return true;
+}
+
+//==============================================================================
+bool LaneStatistics::dirty() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _dirty;
+}
+
+//==============================================================================
+std::size_t LaneStatistics::size() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _entries.size();
+}
+
+//==============================================================================
+double LaneStatistics::_ratio(std::size_t from_wp, std::size_t to_wp) const
+{
+  const auto it = _entries.find(_key(from_wp, to_wp));
+  if (it == _entries.end() || it->second.count < _min_samples)
+    return 1.0;
+
+  // The mean of a lane that sometimes takes twice as long as other times is
+  // not a better guess than the nominal time
+  if (it->second.variance > _max_variance)
+    return 1.0;
+
+  return it->second.mean;
+}
+
+//==============================================================================
+uint64_t LaneStatistics::_key(std::size_t from_wp, std::size_t to_wp)
+{
+  return (static_cast<uint64_t>(from_wp) << 32)
+    | static_cast<uint64_t>(to_wp & 0xFFFFFFFF);
+}
+
+} // namespace rmf
+} // namespace free_fleet
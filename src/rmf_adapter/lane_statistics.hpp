@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__LANE_STATISTICS_HPP
+#define SRC__RMF_ADAPTER__LANE_STATISTICS_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <rmf_utils/optional.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Learns how long robots actually take to traverse each lane of the
+/// navigation graph. Each observation is the ratio of the observed traversal
+/// time to the nominal time that the vehicle traits predict, so a lane that is
+/// consistently slow ends up with a ratio above one. The ratios are tracked as
+/// an exponentially weighted mean and variance, so the statistics follow
+/// changes in the environment. A lane whose ratios vary too much to predict
+/// anything is treated as nominal. Every function is safe to call from any
+/// thread.
+class LaneStatistics
+{
+public:
+
+  struct Entry
+  {
+    double mean = 1.0;
+    double variance = 0.0;
+    uint64_t count = 0;
+  };
+
+  /// One lane of a run of lanes, with its nominal traversal time in seconds
+  struct Traversal
+  {
+    std::size_t from_wp;
+    std::size_t to_wp;
+    double nominal;
+  };
+
+  /// alpha is the weight of each new observation. A lane is only used for
+  /// estimates once it has at least min_samples observations, and while the
+  /// standard deviation of its ratio stays within max_deviation.
+  LaneStatistics(double alpha, uint64_t min_samples, double max_deviation);
+
+  /// Count an observed traversal of the lane between two graph waypoints
+  void observe(std::size_t from_wp, std::size_t to_wp, double ratio);
+
+  /// Count a run of consecutive lanes that took the observed number of
+  /// seconds in total. Robots only report the ends of the runs that they are
+  /// commanded to follow, so the time is spread over the lanes in proportion
+  /// to their nominal times.
+  void observe(const std::vector<Traversal>& lanes, double observed);
+
+  /// The factor to scale the nominal traversal time of a lane by. This is one
+  /// for lanes that do not have enough observations yet.
+  double ratio(std::size_t from_wp, std::size_t to_wp) const;
+
+  /// The factor to scale the nominal traversal time of a run of lanes by,
+  /// weighing each lane by its nominal time
+  double ratio(const std::vector<Traversal>& lanes) const;
+
+  rmf_utils::optional<Entry> entry(
+    std::size_t from_wp,
+    std::size_t to_wp) const;
+
+  /// Replace the statistics with the ones in a file that was saved for a
+  /// graph with the same number of waypoints. Returns false if the file
+  /// cannot be read or belongs to a different graph.
+  bool load(const std::string& path, std::size_t num_waypoints);
+
+  /// Write the statistics to a file, replacing it atomically. Returns false
+  /// if the file cannot be written.
+  bool save(const std::string& path, std::size_t num_waypoints) const;
+
+  /// True if there are observations that have not been saved yet
+  bool dirty() const;
+
+  std::size_t size() const;
+
+private:
+
+  static uint64_t _key(std::size_t from_wp, std::size_t to_wp);
+
+  void _observe(std::size_t from_wp, std::size_t to_wp, double ratio);
+
+  double _ratio(std::size_t from_wp, std::size_t to_wp) const;
+
+  double _alpha;
+  uint64_t _min_samples;
+  double _max_variance;
+  mutable std::mutex _mutex;
+  mutable bool _dirty = false;
+  std::unordered_map<uint64_t, Entry> _entries;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__LANE_STATISTICS_HPP
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstdint>
+#include <algorithm>
+
+#include "monotonic_arena.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+MonotonicArena::MonotonicArena(std::size_t initial_capacity)
+{
+  _add_block(std::max<std::size_t>(initial_capacity, 64));
+}
+
+//==============================================================================
+void* MonotonicArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+  if (bytes == 0)
+    bytes = 1;
+
+  auto try_allocate = [&]() -> void*
+    {
+      Block& block = _blocks.back();
+      const std::uintptr_t base =
+        reinterpret_cast<std::uintptr_t>(block.data.get());
+      const std::uintptr_t start =
+        (base + _offset + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+      const std::size_t end = static_cast<std::size_t>(start - base) + bytes;
+      if (end > block.size)
+        return nullptr;
+
+      _used += end - _offset;
+      _offset = end;
+      return reinterpret_cast<void*>(start);
+    };
+
+  if (void* ptr = try_allocate())
+    return ptr;
+
+  _add_block(std::max(bytes + alignment, 2 * _blocks.back().size));
+  return try_allocate();
+}
+
+//==============================================================================
+void MonotonicArena::reset()
+{
+  if (_blocks.size() > 1)
+  {
+    std::size_t total = 0;
+    for (const auto& block : _blocks)
+      total += block.size;
+
+    _blocks.clear();
+    _add_block(total);
+  }
+
+  _offset = 0;
+  _used = 0;
+}
+
+//==============================================================================
+std::size_t MonotonicArena::used() const
+{
+  return _used;
+}
+
+//==============================================================================
+std::size_t MonotonicArena::capacity() const
+{
+  std::size_t total = 0;
+  for (const auto& block : _blocks)
+    total += block.size;
+  return total;
+}
+
+//==============================================================================
+void MonotonicArena::_add_block(std::size_t minimum_size)
+{
+  _blocks.push_back(
+    Block{std::unique_ptr<unsigned char[]>(new unsigned char[minimum_size]),
+      minimum_size});
+  _offset = 0;
+}
+
+} // namespace rmf
+} // namespace free_fleet
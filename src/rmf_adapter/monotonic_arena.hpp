@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__MONOTONIC_ARENA_HPP
+#define SRC__RMF_ADAPTER__MONOTONIC_ARENA_HPP
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// A bump allocator that only ever grows until it is reset. Deallocation is a
+/// no-op. When reset() is called with more than one block in use, the blocks
+/// are coalesced into a single block large enough for everything that was
+/// allocated, so a workload of steady size stops touching the heap after the
+/// first few resets.
+class MonotonicArena
+{
+public:
+
+  explicit MonotonicArena(std::size_t initial_capacity = 4096);
+
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  /// Get a block of memory with the requested size and alignment. The memory
+  /// stays valid until the next call to reset().
+  void* allocate(std::size_t bytes, std::size_t alignment);
+
+  /// Release everything that was allocated. Any object that still lives in
+  /// the arena must be destroyed before this is called.
+  void reset();
+
+  /// Total number of bytes that have been handed out since the last reset.
+  std::size_t used() const;
+
+  /// Total number of bytes that the arena holds from the heap.
+  std::size_t capacity() const;
+
+private:
+
+  struct Block
+  {
+    std::unique_ptr<unsigned char[]> data;
+    std::size_t size;
+  };
+
+  void _add_block(std::size_t minimum_size);
+
+  std::vector<Block> _blocks;
+  std::size_t _offset = 0;
+  std::size_t _used = 0;
+};
+
+//==============================================================================
+/// Standard allocator adapter for MonotonicArena so that standard containers
+/// can keep their storage inside the arena.
+template<typename T>
+class ArenaAllocator
+{
+public:
+
+  using value_type = T;
+
+  explicit ArenaAllocator(MonotonicArena& arena)
+  : _arena(&arena)
+  {}
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+  : _arena(other.arena())
+  {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, std::size_t)
+  {
+    // Memory is only reclaimed when the arena gets reset.
+  }
+
+  MonotonicArena* arena() const
+  {
+    return _arena;
+  }
+
+private:
+  MonotonicArena* _arena;
+};
+
+//==============================================================================
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return lhs.arena() == rhs.arena();
+}
+
+//==============================================================================
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return !(lhs == rhs);
+}
+
+//==============================================================================
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__MONOTONIC_ARENA_HPP
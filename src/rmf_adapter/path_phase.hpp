@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__PATH_PHASE_HPP
+#define SRC__RMF_ADAPTER__PATH_PHASE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include <free_fleet/messages/RobotMode.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// The phase that a robot's command is in
+enum class PathPhase : uint8_t
+{
+  Idle,
+  Navigating,
+  Waiting,
+  Docking,
+  Finished,
+  Count
+};
+
+//==============================================================================
+/// Everything that can move a robot from one phase to another
+enum class PathInput : uint8_t
+{
+  PathAccepted,
+  DockRequested,
+  RobotWaiting,
+  RobotMoving,
+  PathCompleted,
+  DockCompleted,
+  Stopped,
+  Abandoned,
+  Count
+};
+
+//==============================================================================
+/// The transition table of the path following state machine. Looking up the
+/// next phase is a single indexed load; inputs that do not apply to a phase
+/// map back onto that same phase.
+struct PathTransitions
+{
+  static constexpr std::size_t NumPhases =
+    static_cast<std::size_t>(PathPhase::Count);
+  static constexpr std::size_t NumInputs =
+    static_cast<std::size_t>(PathInput::Count);
+
+  using P = PathPhase;
+
+  // Columns are in the order of PathInput: PathAccepted, DockRequested,
+  // RobotWaiting, RobotMoving, PathCompleted, DockCompleted, Stopped,
+  // Abandoned
+  static constexpr PathPhase table[NumPhases][NumInputs] = {
+    // Idle
+    {P::Navigating, P::Docking, P::Idle, P::Idle,
+      P::Idle, P::Idle, P::Idle, P::Idle},
+    // Navigating
+    {P::Navigating, P::Docking, P::Waiting, P::Navigating,
+      P::Finished, P::Navigating, P::Idle, P::Idle},
+    // Waiting
+    {P::Navigating, P::Docking, P::Waiting, P::Navigating,
+      P::Finished, P::Waiting, P::Idle, P::Idle},
+    // Docking
+    {P::Navigating, P::Docking, P::Docking, P::Docking,
+      P::Docking, P::Finished, P::Idle, P::Idle},
+    // Finished
+    {P::Navigating, P::Docking, P::Finished, P::Finished,
+      P::Finished, P::Finished, P::Idle, P::Idle}
+  };
+
+  static constexpr PathPhase next(PathPhase phase, PathInput input)
+  {
+    return table[static_cast<std::size_t>(phase)]
+      [static_cast<std::size_t>(input)];
+  }
+
+  /// Translate the mode a robot reports into an input for the table
+  static constexpr PathInput from_mode(uint32_t mode)
+  {
+    return mode == messages::RobotMode::MODE_WAITING
+      || mode == messages::RobotMode::MODE_PAUSED ?
+      PathInput::RobotWaiting : PathInput::RobotMoving;
+  }
+
+  /// True if the phase means that the robot has a command in progress
+  static constexpr bool is_active(PathPhase phase)
+  {
+    return phase == PathPhase::Navigating
+      || phase == PathPhase::Waiting
+      || phase == PathPhase::Docking;
+  }
+
+  /// Checked at compile time below: every entry is a real phase, stopping or
+  /// abandoning a command always returns to Idle, new commands always win, and
+  /// no robot-reported input can start or finish a command on its own.
+  static constexpr bool is_consistent()
+  {
+    for (std::size_t p = 0; p < NumPhases; ++p)
+    {
+      const auto phase = static_cast<PathPhase>(p);
+      for (std::size_t i = 0; i < NumInputs; ++i)
+      {
+        if (table[p][i] >= PathPhase::Count)
+          return false;
+      }
+
+      if (next(phase, PathInput::Stopped) != PathPhase::Idle
+        || next(phase, PathInput::Abandoned) != PathPhase::Idle
+        || next(phase, PathInput::PathAccepted) != PathPhase::Navigating
+        || next(phase, PathInput::DockRequested) != PathPhase::Docking)
+        return false;
+
+      for (const auto input :
+        {PathInput::RobotWaiting, PathInput::RobotMoving})
+      {
+        if (is_active(phase) != is_active(next(phase, input)))
+          return false;
+      }
+
+      for (const auto input :
+        {PathInput::PathCompleted, PathInput::DockCompleted})
+      {
+        const auto result = next(phase, input);
+        if (result != phase && result != PathPhase::Finished)
+          return false;
+      }
+    }
+
+    return next(PathPhase::Navigating, PathInput::PathCompleted)
+      == PathPhase::Finished
+      && next(PathPhase::Waiting, PathInput::PathCompleted)
+      == PathPhase::Finished
+      && next(PathPhase::Docking, PathInput::DockCompleted)
+      == PathPhase::Finished
+      && next(PathPhase::Navigating, PathInput::RobotWaiting)
+      == PathPhase::Waiting
+      && next(PathPhase::Waiting, PathInput::RobotMoving)
+      == PathPhase::Navigating;
+  }
+};
+
+static_assert(
+  PathTransitions::is_consistent(),
+  "The path following transition table is inconsistent");
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__PATH_PHASE_HPP
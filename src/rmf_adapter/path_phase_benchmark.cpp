@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Measures the cost of one path phase transition with the transition table,
+// against the nested switch that the table replaced, over a random stream of
+// inputs that defeats the branch predictor the way a busy fleet does.
+//
+// Usage: path_phase_benchmark [--repeat R] [transitions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "path_phase.hpp"
+
+namespace {
+
+using free_fleet::rmf::PathPhase;
+using free_fleet::rmf::PathInput;
+using free_fleet::rmf::PathTransitions;
+
+//==============================================================================
+/// The dispatch that the transition table replaced
+PathPhase switch_next(PathPhase phase, PathInput input)
+{
+  switch (phase)
+  {
+    case PathPhase::Idle:
+      switch (input)
+      {
+        case PathInput::PathAccepted: return PathPhase::Navigating;
+        case PathInput::DockRequested: return PathPhase::Docking;
+        default: return PathPhase::Idle;
+      }
+    case PathPhase::Navigating:
+      switch (input)
+      {
+        case PathInput::DockRequested: return PathPhase::Docking;
+        case PathInput::RobotWaiting: return PathPhase::Waiting;
+        case PathInput::PathCompleted: return PathPhase::Finished;
+        case PathInput::Stopped:
+        case PathInput::Abandoned: return PathPhase::Idle;
+        default: return PathPhase::Navigating;
+      }
+    case PathPhase::Waiting:
+      switch (input)
+      {
+        case PathInput::PathAccepted:
+        case PathInput::RobotMoving: return PathPhase::Navigating;
+        case PathInput::DockRequested: return PathPhase::Docking;
+        case PathInput::PathCompleted: return PathPhase::Finished;
+        case PathInput::Stopped:
+        case PathInput::Abandoned: return PathPhase::Idle;
+        default: return PathPhase::Waiting;
+      }
+    case PathPhase::Docking:
+      switch (input)
+      {
+        case PathInput::PathAccepted: return PathPhase::Navigating;
+        case PathInput::DockCompleted: return PathPhase::Finished;
+        case PathInput::Stopped:
+        case PathInput::Abandoned: return PathPhase::Idle;
+        default: return PathPhase::Docking;
+      }
+    default:
+      switch (input)
+      {
+        case PathInput::PathAccepted: return PathPhase::Navigating;
+        case PathInput::DockRequested: return PathPhase::Docking;
+        case PathInput::Stopped:
+        case PathInput::Abandoned: return PathPhase::Idle;
+        default: return PathPhase::Finished;
+      }
+  }
+}
+
+//==============================================================================
+/// Run every input through the dispatch, and return the nanoseconds per
+/// transition. The final phase is folded into the checksum so that the loop
+/// cannot be optimized away.
+template<typename Next>
+double run(
+  const std::vector<PathInput>& inputs,
+  Next next,
+  std::size_t& checksum)
+{
+  PathPhase phase = PathPhase::Idle;
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto input : inputs)
+  {
+    phase = next(phase, input);
+    checksum += static_cast<std::size_t>(phase);
+  }
+  const auto finish = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(finish - start).count()
+    / static_cast<double>(inputs.size());
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  std::size_t transitions = 10000000;
+  std::size_t repeat = 5;
+  bool valid = true;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (arg == "--repeat" && i + 1 < argc)
+      repeat = std::strtoul(argv[++i], nullptr, 10);
+    else if (!arg.empty() && arg[0] != '-')
+      transitions = std::strtoul(arg.c_str(), nullptr, 10);
+    else
+      valid = false;
+  }
+
+  if (!valid || transitions == 0 || repeat == 0)
+  {
+    std::fprintf(
+      stderr, "Usage: %s [--repeat R] [transitions]\n", argv[0]);
+    return 1;
+  }
+
+  // Robot reported inputs dominate in practice, so they are drawn more often
+  // than the commands that start and stop paths.
+  std::mt19937 rng(42);
+  std::discrete_distribution<int> draw({1, 1, 8, 8, 1, 1, 1, 1});
+  std::vector<PathInput> inputs(transitions);
+  for (auto& input : inputs)
+    input = static_cast<PathInput>(draw(rng));
+
+  for (std::size_t i = 0; i < PathTransitions::NumInputs; ++i)
+  {
+    for (std::size_t p = 0; p < PathTransitions::NumPhases; ++p)
+    {
+      const auto input = static_cast<PathInput>(i);
+      const auto phase = static_cast<PathPhase>(p);
+      if (switch_next(phase, input) != PathTransitions::next(phase, input))
+      {
+        std::fprintf(stderr, "The switch and the table disagree\n");
+        return 1;
+      }
+    }
+  }
+
+  std::printf("%10s %14s %14s\n", "run", "table ns/op", "switch ns/op");
+  std::size_t checksum = 0;
+  for (std::size_t r = 0; r < repeat; ++r)
+  {
+    const double table = run(inputs, &PathTransitions::next, checksum);
+    const double nested = run(inputs, &switch_next, checksum);
+    std::printf("%10zu %14.3f %14.3f\n", r, table, nested);
+  }
+
+  std::printf("checksum %zu\n", checksum);
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+
+#include "path_simplifier.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+double angle_difference(double a, double b)
+{
+  return std::abs(std::remainder(a - b, 2.0 * M_PI));
+}
+
+} // anonymous namespace
+
+//==============================================================================
+bool fits_segment(
+  const Eigen::Vector3d& p0,
+  double t0,
+  const Eigen::Vector3d& p1,
+  double t1,
+  const Eigen::Vector3d& p,
+  double t,
+  const PathSimplification& params)
+{
+  const Eigen::Vector2d segment = p1.head<2>() - p0.head<2>();
+  const Eigen::Vector2d offset = p.head<2>() - p0.head<2>();
+  const double length = segment.norm();
+
+  double fraction = 0.0;
+  double deviation = offset.norm();
+  if (length > 1e-6)
+  {
+    const Eigen::Vector2d direction = segment / length;
+    const double along = offset.dot(direction);
+    fraction = along / length;
+    if (fraction < 0.0 || fraction > 1.0)
+      return false;
+
+    deviation = std::abs(direction[0] * offset[1] - direction[1] * offset[0]);
+  }
+
+  if (deviation > params.collinear_tolerance)
+    return false;
+
+  if (angle_difference(p[2], p1[2]) > params.yaw_tolerance)
+    return false;
+
+  const double expected = t0 + fraction * (t1 - t0);
+  return std::abs(t - expected) <= params.timing_tolerance;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__PATH_SIMPLIFIER_HPP
+#define SRC__RMF_ADAPTER__PATH_SIMPLIFIER_HPP
+
+#include <cstddef>
+
+#include <rmf_traffic/agv/Planner.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Tolerances for dropping waypoints that do not change how a robot moves
+struct PathSimplification
+{
+  bool enabled = true;
+
+  /// How far, in meters, a dropped waypoint may lie from the straight line
+  /// that replaces it
+  double collinear_tolerance = 0.05;
+
+  /// How far, in radians, the heading at a dropped waypoint may differ from
+  /// the heading at the end of the line that replaces it
+  double yaw_tolerance = 0.05;
+
+  /// How far, in seconds, the time of a dropped waypoint may differ from the
+  /// time at which the robot would pass that point when moving along the
+  /// replacing line at constant speed. This keeps every waypoint where the
+  /// robot is scheduled to wait, speed up or slow down.
+  double timing_tolerance = 0.5;
+};
+
+//==============================================================================
+/// True if a waypoint at position p, passed at time t, can be dropped from a
+/// straight segment that goes from p0 at time t0 to p1 at time t1. Positions
+/// hold x, y and yaw, and times are in seconds.
+bool fits_segment(
+  const Eigen::Vector3d& p0,
+  double t0,
+  const Eigen::Vector3d& p1,
+  double t1,
+  const Eigen::Vector3d& p,
+  double t,
+  const PathSimplification& params);
+
+//==============================================================================
+/// True if every waypoint strictly between from and to can be dropped, so
+/// that the robot drives straight from waypoint from to waypoint to without
+/// changing when it passes any point along the way. Waypoints with lane events
+/// can never be dropped.
+///
+/// Waypoint is rmf_traffic::agv::Plan::Waypoint, or anything else that has
+/// its position(), time() and event().
+template<typename Waypoint>
+bool can_merge(
+  const Waypoint* waypoints,
+  std::size_t from,
+  std::size_t to,
+  const PathSimplification& params)
+{
+  const auto seconds = [](const Waypoint& wp)
+    {
+      return rmf_traffic::time::to_seconds(wp.time().time_since_epoch());
+    };
+
+  const auto& start = waypoints[from];
+  const auto& end = waypoints[to];
+  const Eigen::Vector3d p0 = start.position();
+  const Eigen::Vector3d p1 = end.position();
+  const double t0 = seconds(start);
+  const double t1 = seconds(end);
+
+  for (std::size_t i = from + 1; i < to; ++i)
+  {
+    const auto& wp = waypoints[i];
+    if (wp.event())
+      return false;
+
+    if (!fits_segment(p0, t0, p1, t1, wp.position(), seconds(wp), params))
+      return false;
+  }
+
+  return true;
+}
+
+//==============================================================================
+/// Call keep(i) in order for every waypoint i of the plan that must be sent to
+/// the robot. The first and last waypoints are always kept. Each kept waypoint
+/// is extended greedily for as long as the intermediate waypoints can be
+/// merged into one straight segment.
+template<typename Waypoint, typename KeepFn>
+void simplify_path(
+  const Waypoint* waypoints,
+  std::size_t count,
+  const PathSimplification& params,
+  KeepFn&& keep)
+{
+  if (count == 0)
+    return;
+
+  std::size_t last_kept = 0;
+  keep(last_kept);
+  for (std::size_t i = 1; i + 1 < count; ++i)
+  {
+    if (params.enabled && can_merge(waypoints, last_kept, i + 1, params))
+      continue;
+
+    last_kept = i;
+    keep(last_kept);
+  }
+
+  if (count > 1)
+    keep(count - 1);
+}
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__PATH_SIMPLIFIER_HPP
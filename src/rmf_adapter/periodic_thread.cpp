@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "periodic_thread.hpp"
+
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <rclcpp/logging.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+PeriodicThread::PeriodicThread(
+  std::string name,
+  std::chrono::nanoseconds period,
+  std::function<void()> work,
+  ThreadSettings settings,
+  rclcpp::Logger logger)
+: _state(std::make_shared<State>(
+      std::move(name), period, std::move(work), std::move(settings),
+      std::move(logger)))
+{
+  _thread = std::thread([state = _state]() { _run(state); });
+}
+
+//==============================================================================
+PeriodicThread::State::State(
+  std::string name_,
+  std::chrono::nanoseconds period_,
+  std::function<void()> work_,
+  ThreadSettings settings_,
+  rclcpp::Logger logger_)
+: name(std::move(name_)),
+  period(period_),
+  work(std::move(work_)),
+  settings(std::move(settings_)),
+  logger(std::move(logger_))
+{}
+
+//==============================================================================
+PeriodicThread::~PeriodicThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->stopping = true;
+  }
+  _state->cv.notify_all();
+
+  // The work itself may end up releasing the last owner of this object, in
+  // which case the thread cannot wait for itself. It only touches the shared
+  // state from then on, and finishes once the work returns.
+  if (_thread.get_id() == std::this_thread::get_id())
+    _thread.detach();
+  else if (_thread.joinable())
+    _thread.join();
+}
+
+//==============================================================================
+void PeriodicThread::_run(const std::shared_ptr<State>& state)
+{
+  _apply_settings(*state);
+
+  auto next = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (!state->stopping)
+  {
+    lock.unlock();
+    state->work();
+    lock.lock();
+
+    // A run that overshoots its period is followed right away by the next
+    // one instead of a burst of runs that try to catch up.
+    next += state->period;
+    const auto now = std::chrono::steady_clock::now();
+    if (next < now)
+      next = now;
+
+    state->cv.wait_until(lock, next, [&state]() { return state->stopping; });
+  }
+}
+
+//==============================================================================
+void PeriodicThread::_apply_settings(const State& state)
+{
+  const pthread_t self = pthread_self();
+
+  if (!state.settings.cpus.empty())
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const int cpu : state.settings.cpus)
+    {
+      if (cpu < 0 || cpu >= CPU_SETSIZE)
+      {
+        RCLCPP_WARN(state.logger, "Ignoring invalid CPU index [%d]", cpu);
+        continue;
+      }
+      CPU_SET(cpu, &cpus);
+    }
+
+    const int error = CPU_COUNT(&cpus) == 0 ?
+      EINVAL : pthread_setaffinity_np(self, sizeof(cpus), &cpus);
+    if (error != 0)
+    {
+      RCLCPP_WARN(
+        state.logger,
+        "Failed to pin the [%s] thread to its CPUs, it will run on any CPU: "
+        "%s", state.name.c_str(), std::strerror(error));
+    }
+  }
+
+  if (state.settings.priority > 0)
+  {
+    sched_param param;
+    param.sched_priority = state.settings.priority;
+    const int error = pthread_setschedparam(self, SCHED_FIFO, &param);
+    if (error != 0)
+    {
+      RCLCPP_WARN(
+        state.logger,
+        "Failed to give the [%s] thread SCHED_FIFO priority %d, it will use "
+        "the default scheduling policy: %s", state.name.c_str(),
+        state.settings.priority, std::strerror(error));
+    }
+  }
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__PERIODIC_THREAD_HPP
+#define SRC__RMF_ADAPTER__PERIODIC_THREAD_HPP
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <rclcpp/logger.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Where and how urgently a dedicated thread gets scheduled
+struct ThreadSettings
+{
+  /// The CPUs the thread may run on. Empty leaves the affinity alone.
+  std::vector<int> cpus;
+
+  /// SCHED_FIFO priority of the thread, between 1 and 99. Zero keeps the
+  /// default scheduling policy.
+  int priority = 0;
+};
+
+//==============================================================================
+/// Runs a piece of work periodically on a thread of its own, so that it does
+/// not compete with the executor threads for time. If the scheduling settings
+/// cannot be applied, for example because the process lacks the privileges
+/// for real-time scheduling, a warning is logged and the thread keeps running
+/// with whatever settings it has.
+class PeriodicThread
+{
+public:
+
+  PeriodicThread(
+    std::string name,
+    std::chrono::nanoseconds period,
+    std::function<void()> work,
+    ThreadSettings settings,
+    rclcpp::Logger logger);
+
+  /// Stops the thread and waits for the work in progress to finish
+  ~PeriodicThread();
+
+  PeriodicThread(const PeriodicThread&) = delete;
+  PeriodicThread& operator=(const PeriodicThread&) = delete;
+
+private:
+
+  /// Everything the thread uses. The thread shares ownership of it, so that
+  /// it stays valid when the work ends up destroying this object on the
+  /// thread itself.
+  struct State
+  {
+    State(
+      std::string name,
+      std::chrono::nanoseconds period,
+      std::function<void()> work,
+      ThreadSettings settings,
+      rclcpp::Logger logger);
+
+    std::string name;
+    std::chrono::nanoseconds period;
+    std::function<void()> work;
+    ThreadSettings settings;
+    rclcpp::Logger logger;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+  };
+
+  static void _run(const std::shared_ptr<State>& state);
+
+  static void _apply_settings(const State& state);
+
+  std::shared_ptr<State> _state;
+  std::thread _thread;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__PERIODIC_THREAD_HPP
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "proximity_index.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+constexpr uint64_t ProximityIndex::NoCell;
+
+namespace {
+//==============================================================================
+/// Cell coordinates are kept to 24 bits in the cell keys
+constexpr double CellWrap = static_cast<double>(1 << 24);
+
+//==============================================================================
+/// Cell coordinates are clamped to this, so that far away or huge inputs
+/// cannot overflow the conversion to an integer
+constexpr double MaxCellCoordinate = 1e15;
+
+} // anonymous namespace
+
+//==============================================================================
+ProximityIndex::ProximityIndex(double cell_size)
+: _cell_size(cell_size)
+{}
+
+//==============================================================================
+void ProximityIndex::update(const RobotStateTable& table, Index slot)
+{
+  if (slot >= _cell_of.size())
+  {
+    _cell_of.resize(slot + 1, NoCell);
+    _position_in_cell.resize(slot + 1, 0);
+  }
+
+  const uint16_t level = table.level[slot];
+  const double x = table.x[slot];
+  const double y = table.y[slot];
+  const uint64_t key =
+    level == RobotStateTable::NoLevel || !std::isfinite(x)
+    || !std::isfinite(y) ?
+    NoCell : _cell_key(level, _cell_coordinate(x), _cell_coordinate(y));
+
+  if (key == _cell_of[slot])
+    return;
+
+  _remove(slot);
+  if (key == NoCell)
+    return;
+
+  auto& cell = _cells[key];
+  _cell_of[slot] = key;
+  _position_in_cell[slot] = cell.size();
+  cell.push_back(slot);
+  ++_size;
+}
+
+//==============================================================================
+void ProximityIndex::query(
+  const RobotStateTable& table,
+  uint16_t level,
+  double x,
+  double y,
+  double radius,
+  std::vector<Index>& output) const
+{
+  output.clear();
+  if (_cells.empty() || !std::isfinite(x) || !std::isfinite(y)
+    || !std::isfinite(radius) || radius < 0.0)
+    return;
+
+  const int64_t min_cx = _cell_coordinate(x - radius);
+  const int64_t max_cx = _cell_coordinate(x + radius);
+  const int64_t min_cy = _cell_coordinate(y - radius);
+  const int64_t max_cy = _cell_coordinate(y + radius);
+  const double radius_squared = radius * radius;
+
+  // Past this many cells, visiting them costs more than checking every robot.
+  // Ranges wider than the wrap around of the cell keys would also visit some
+  // cells twice.
+  const double cells_x = static_cast<double>(max_cx - min_cx) + 1.0;
+  const double cells_y = static_cast<double>(max_cy - min_cy) + 1.0;
+  if (cells_x * cells_y > static_cast<double>(_size)
+    || cells_x > CellWrap || cells_y > CellWrap)
+  {
+    _scan(table, level, x, y, radius_squared, output);
+    return;
+  }
+
+  for (int64_t cx = min_cx; cx <= max_cx; ++cx)
+  {
+    for (int64_t cy = min_cy; cy <= max_cy; ++cy)
+    {
+      const auto cell = _cells.find(_cell_key(level, cx, cy));
+      if (cell == _cells.end())
+        continue;
+
+      for (const Index slot : cell->second)
+      {
+        const double dx = table.x[slot] - x;
+        const double dy = table.y[slot] - y;
+        if (dx * dx + dy * dy <= radius_squared)
+          output.push_back(slot);
+      }
+    }
+  }
+}
+
+//==============================================================================
+void ProximityIndex::neighbors(
+  const RobotStateTable& table,
+  Index slot,
+  double radius,
+  std::vector<Index>& output) const
+{
+  output.clear();
+  if (slot >= _cell_of.size() || _cell_of[slot] == NoCell)
+    return;
+
+  query(table, table.level[slot], table.x[slot], table.y[slot], radius,
+    output);
+
+  for (std::size_t i = 0; i < output.size(); ++i)
+  {
+    if (output[i] == slot)
+    {
+      output[i] = output.back();
+      output.pop_back();
+      break;
+    }
+  }
+}
+
+//==============================================================================
+uint64_t ProximityIndex::_cell_key(
+  uint16_t level,
+  int64_t cx,
+  int64_t cy) const
+{
+  // 24 bits per coordinate covers more than ten thousand kilometers of floor
+  // at any sensible cell size. Coordinates wrap beyond that, which only
+  // costs extra distance checks.
+  return (static_cast<uint64_t>(level) << 48)
+    | ((static_cast<uint64_t>(cx) & 0xFFFFFF) << 24)
+    | (static_cast<uint64_t>(cy) & 0xFFFFFF);
+}
+
+//==============================================================================
+int64_t ProximityIndex::_cell_coordinate(double value) const
+{
+  const double cell = std::floor(value / _cell_size);
+  return static_cast<int64_t>(
+    std::max(-MaxCellCoordinate, std::min(cell, MaxCellCoordinate)));
+}
+
+//==============================================================================
+void ProximityIndex::_scan(
+  const RobotStateTable& table,
+  uint16_t level,
+  double x,
+  double y,
+  double radius_squared,
+  std::vector<Index>& output) const
+{
+  for (const auto& cell : _cells)
+  {
+    if ((cell.first >> 48) != level)
+      continue;
+
+    for (const Index slot : cell.second)
+    {
+      const double dx = table.x[slot] - x;
+      const double dy = table.y[slot] - y;
+      if (dx * dx + dy * dy <= radius_squared)
+        output.push_back(slot);
+    }
+  }
+}
+
+//==============================================================================
+void ProximityIndex::_remove(Index slot)
+{
+  const uint64_t key = _cell_of[slot];
+  if (key == NoCell)
+    return;
+
+  const auto cell = _cells.find(key);
+  auto& members = cell->second;
+  const std::size_t position = _position_in_cell[slot];
+  const Index moved = members.back();
+  members[position] = moved;
+  _position_in_cell[moved] = position;
+  members.pop_back();
+  if (members.empty())
+    _cells.erase(cell);
+
+  _cell_of[slot] = NoCell;
+  --_size;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__PROXIMITY_INDEX_HPP
+#define SRC__RMF_ADAPTER__PROXIMITY_INDEX_HPP
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "robot_state_table.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// A uniform grid over the robots of each level, for finding the robots near a
+/// point without looking at the whole fleet. A robot only gets moved in the
+/// grid when it crosses into another cell, so most updates cost a single
+/// comparison. Positions are read from the state table that the slots belong
+/// to, and the index must be updated whenever that table is.
+class ProximityIndex
+{
+public:
+
+  using Index = RobotStateTable::Index;
+
+  /// cell_size is the side length of each grid cell in meters. Queries are
+  /// cheapest when it is close to the typical query radius.
+  ProximityIndex(double cell_size);
+
+  /// Place the robot in a slot according to its latest entry in the table
+  void update(const RobotStateTable& table, Index slot);
+
+  /// Collect the robots on a level within radius of a point. The output is
+  /// cleared first, and stays empty if any of the inputs is not finite. When
+  /// the radius spans more cells than there are robots in the index, the
+  /// robots are scanned directly instead of the cells.
+  void query(
+    const RobotStateTable& table,
+    uint16_t level,
+    double x,
+    double y,
+    double radius,
+    std::vector<Index>& output) const;
+
+  /// Collect the other robots within radius of the robot in a slot. The
+  /// output is cleared first.
+  void neighbors(
+    const RobotStateTable& table,
+    Index slot,
+    double radius,
+    std::vector<Index>& output) const;
+
+private:
+
+  static constexpr uint64_t NoCell = UINT64_MAX;
+
+  uint64_t _cell_key(uint16_t level, int64_t cx, int64_t cy) const;
+
+  int64_t _cell_coordinate(double value) const;
+
+  void _scan(
+    const RobotStateTable& table,
+    uint16_t level,
+    double x,
+    double y,
+    double radius_squared,
+    std::vector<Index>& output) const;
+
+  void _remove(Index slot);
+
+  double _cell_size;
+
+  /// The robots in each occupied cell
+  std::unordered_map<uint64_t, std::vector<Index>> _cells;
+
+  /// For each slot, the key of its cell and its position within that cell's
+  /// list, so that moving it out of a cell takes constant time
+  std::vector<uint64_t> _cell_of;
+  std::vector<std::size_t> _position_in_cell;
+
+  /// How many robots are in the grid
+  std::size_t _size = 0;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__PROXIMITY_INDEX_HPP
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "robot_state_table.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+constexpr uint16_t RobotStateTable::NoLevel;
+constexpr std::size_t RobotStateTable::MaxLevels;
+
+namespace {
+//==============================================================================
+template<typename T>
+std::size_t array_bytes(const CacheAlignedVector<T>& array)
+{
+  return array.capacity() * sizeof(T);
+}
+
+//==============================================================================
+/// Estimate of what one entry of a node based hash map costs: the node with
+/// its next pointer, the key's heap storage, and its share of the buckets
+template<typename Map>
+std::size_t map_bytes(const Map& map)
+{
+  std::size_t bytes = map.bucket_count() * sizeof(void*)
+    + map.size() * (sizeof(typename Map::value_type) + sizeof(void*));
+  for (const auto& entry : map)
+    bytes += heap_bytes(entry.first);
+
+  return bytes;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+void RobotStateTable::reserve(std::size_t robot_count)
+{
+  x.reserve(robot_count);
+  y.reserve(robot_count);
+  yaw.reserve(robot_count);
+  level.reserve(robot_count);
+  cursor.reserve(robot_count);
+  last_seen.reserve(robot_count);
+  mode.reserve(robot_count);
+  _slots.reserve(robot_count);
+}
+
+//==============================================================================
+std::pair<RobotStateTable::Index, bool> RobotStateTable::insert(
+  const std::string& robot_name)
+{
+  const auto insertion = _slots.insert({robot_name, size()});
+  if (!insertion.second)
+    return {insertion.first->second, false};
+
+  x.push_back(0.0);
+  y.push_back(0.0);
+  yaw.push_back(0.0);
+  level.push_back(NoLevel);
+  cursor.push_back(0);
+  last_seen.push_back(0);
+  mode.push_back(0);
+  return {insertion.first->second, true};
+}
+
+//==============================================================================
+rmf_utils::optional<RobotStateTable::Index> RobotStateTable::find(
+  const std::string& robot_name) const
+{
+  const auto it = _slots.find(robot_name);
+  if (it == _slots.end())
+    return rmf_utils::nullopt;
+
+  return it->second;
+}
+
+//==============================================================================
+bool RobotStateTable::update(
+  Index index,
+  const messages::RobotState& state,
+  int64_t now_ns)
+{
+  const auto& loc = state.location;
+  const uint16_t level_index = level_id(loc.level_name);
+  if (level_index == NoLevel)
+    return false;
+
+  x[index] = loc.x;
+  y[index] = loc.y;
+  yaw[index] = loc.yaw;
+  level[index] = level_index;
+  cursor[index] = static_cast<uint32_t>(state.path.size());
+  last_seen[index] = now_ns;
+  mode[index] = static_cast<uint8_t>(state.mode.mode);
+  return true;
+}
+
+//==============================================================================
+uint16_t RobotStateTable::level_id(const std::string& level_name)
+{
+  const auto it = _level_ids.find(level_name);
+  if (it != _level_ids.end())
+    return it->second;
+
+  if (_level_names.size() >= MaxLevels)
+    return NoLevel;
+
+  const auto id = static_cast<uint16_t>(_level_names.size());
+  _level_names.push_back(level_name);
+  _level_ids.insert({level_name, id});
+  return id;
+}
+
+//==============================================================================
+const std::string& RobotStateTable::level_name(uint16_t id) const
+{
+  static const std::string no_level;
+  if (id >= _level_names.size())
+    return no_level;
+
+  return _level_names[id];
+}
+
+//==============================================================================
+std::size_t RobotStateTable::size() const
+{
+  return x.size();
+}
+
+//==============================================================================
+std::size_t RobotStateTable::bytes_per_robot()
+{
+  return 3 * sizeof(double) + sizeof(uint16_t) + sizeof(uint32_t)
+    + sizeof(int64_t) + sizeof(uint8_t);
+}
+
+//==============================================================================
+std::size_t RobotStateTable::memory_bytes() const
+{
+  std::size_t bytes = array_bytes(x) + array_bytes(y) + array_bytes(yaw)
+    + array_bytes(level) + array_bytes(cursor) + array_bytes(last_seen)
+    + array_bytes(mode) + map_bytes(_slots) + map_bytes(_level_ids)
+    + _level_names.capacity() * sizeof(std::string);
+
+  for (const auto& name : _level_names)
+    bytes += heap_bytes(name);
+
+  return bytes;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__ROBOT_STATE_TABLE_HPP
+#define SRC__RMF_ADAPTER__ROBOT_STATE_TABLE_HPP
+
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+
+#include <rmf_utils/optional.hpp>
+
+#include <free_fleet/messages/RobotState.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+constexpr std::size_t CacheLineSize = 64;
+
+//==============================================================================
+/// Allocator that puts the start of every allocation on a cache line boundary,
+/// so that neighbouring arrays never share a line.
+template<typename T>
+class CacheAlignedAllocator
+{
+public:
+
+  using value_type = T;
+
+  CacheAlignedAllocator() = default;
+
+  template<typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U>&)
+  {}
+
+  T* allocate(std::size_t n)
+  {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, CacheLineSize, n * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, std::size_t)
+  {
+    free(ptr);
+  }
+};
+
+//==============================================================================
+template<typename T, typename U>
+bool operator==(
+  const CacheAlignedAllocator<T>&,
+  const CacheAlignedAllocator<U>&)
+{
+  return true;
+}
+
+//==============================================================================
+template<typename T, typename U>
+bool operator!=(
+  const CacheAlignedAllocator<T>&,
+  const CacheAlignedAllocator<U>&)
+{
+  return false;
+}
+
+//==============================================================================
+template<typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+//==============================================================================
+/// Bytes that a string holds on the heap, which is nothing while it fits in
+/// the small string buffer
+inline std::size_t heap_bytes(const std::string& value)
+{
+  return value.capacity() > std::string().capacity() ?
+    value.capacity() + 1 : 0;
+}
+
+//==============================================================================
+/// Dense storage for the per-robot data that gets touched on every state
+/// update. Each field is its own contiguous array so that a pass over one
+/// field for the whole fleet walks memory linearly. Robots are identified by
+/// the slot index they were given when they were first seen, and slots are
+/// never reused.
+struct RobotStateTable
+{
+  using Index = std::size_t;
+
+  /// Sentinel for a robot that has not reported any level yet
+  static constexpr uint16_t NoLevel = UINT16_MAX;
+
+  /// Most distinct level names that can be interned. Every other id is below
+  /// NoLevel, so ids never wrap around or collide with it.
+  static constexpr std::size_t MaxLevels = NoLevel;
+
+  CacheAlignedVector<double> x;
+  CacheAlignedVector<double> y;
+  CacheAlignedVector<double> yaw;
+  CacheAlignedVector<uint16_t> level;
+
+  /// Number of path locations the robot still has to visit
+  CacheAlignedVector<uint32_t> cursor;
+
+  /// Adapter time in nanoseconds when the last state of the robot arrived
+  CacheAlignedVector<int64_t> last_seen;
+
+  CacheAlignedVector<uint8_t> mode;
+
+  /// Make room for the given number of robots up front
+  void reserve(std::size_t robot_count);
+
+  /// Get the slot for a robot, creating one if the robot is new. The second
+  /// element of the result is true if a new slot was created.
+  std::pair<Index, bool> insert(const std::string& robot_name);
+
+  /// Get the slot for a robot if it has one
+  rmf_utils::optional<Index> find(const std::string& robot_name) const;
+
+  /// Copy the hot fields of a new state into the robot's slot. Returns false,
+  /// leaving the slot unchanged, if the state is on a new level and MaxLevels
+  /// levels are already interned.
+  bool update(
+    Index index,
+    const messages::RobotState& state,
+    int64_t now_ns);
+
+  /// Get the id of a level, registering it if it has not been seen before.
+  /// Returns NoLevel for a new level once MaxLevels levels are interned.
+  uint16_t level_id(const std::string& level_name);
+
+  /// Get the name of a level id. Returns an empty string for NoLevel.
+  const std::string& level_name(uint16_t id) const;
+
+  /// Number of robots in the table
+  std::size_t size() const;
+
+  /// Bytes that the hot arrays take up for each robot. This leaves out the
+  /// slot index and the level names, see memory_bytes() for those.
+  static std::size_t bytes_per_robot();
+
+  /// Bytes that the table holds in total, including reserved capacity, the
+  /// slot index with its robot names, and the interned level names
+  std::size_t memory_bytes() const;
+
+private:
+  std::unordered_map<std::string, Index> _slots;
+  std::vector<std::string> _level_names;
+  std::unordered_map<std::string, uint16_t> _level_ids;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__ROBOT_STATE_TABLE_HPP
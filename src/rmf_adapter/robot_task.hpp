@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__ROBOT_TASK_HPP
+#define SRC__RMF_ADAPTER__ROBOT_TASK_HPP
+
+#include <string>
+#include <cstdint>
+
+#include <rmf_traffic/Time.hpp>
+
+#include <free_fleet/messages/RobotState.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// The reasons a suspended robot task can be woken up
+enum class TaskEvent : uint8_t
+{
+  /// The task is being run for the first time
+  Start,
+
+  /// A new state of the robot arrived
+  StateArrived,
+
+  /// A state arrived that carries the task id the routine is waiting on
+  AckReceived,
+
+  /// The deadline of the current suspension has passed
+  Timeout
+};
+
+//==============================================================================
+/// The bookkeeping that every robot task carries between suspensions
+class TaskFrame
+{
+public:
+
+  /// Step value of a routine that has not been started yet
+  static constexpr int Begin = 0;
+
+  /// Step value of a routine that is not running
+  static constexpr int Done = -1;
+
+  /// Abandon the routine without finishing it
+  void cancel()
+  {
+    _step = Done;
+    _succeeded = false;
+    _awaited_task_id.clear();
+    _deadline = rmf_traffic::Time::max();
+  }
+
+  bool done() const
+  {
+    return _step == Done;
+  }
+
+  /// True if the routine ran to completion rather than giving up or being
+  /// cancelled
+  bool succeeded() const
+  {
+    return _succeeded;
+  }
+
+  /// The task id that the routine is waiting for the robot to report, or an
+  /// empty string if it is not waiting for an acknowledgement
+  const std::string& awaited_task_id() const
+  {
+    return _awaited_task_id;
+  }
+
+  /// The time at which the routine should be woken with a Timeout event
+  rmf_traffic::Time deadline() const
+  {
+    return _deadline;
+  }
+
+protected:
+
+  /// Suspend until the next state arrives, resuming at the given step
+  void _await_state(
+    int next_step,
+    rmf_traffic::Duration timeout = rmf_traffic::Duration::max())
+  {
+    _step = next_step;
+    _awaited_task_id.clear();
+    _set_timeout(timeout);
+  }
+
+  /// Suspend until the robot reports the given task id, resuming at the given
+  /// step. States that arrive in the meantime still wake the routine up with
+  /// StateArrived.
+  void _await_ack(
+    const std::string& task_id,
+    int next_step,
+    rmf_traffic::Duration timeout)
+  {
+    _step = next_step;
+    _awaited_task_id = task_id;
+    _set_timeout(timeout);
+  }
+
+  /// Mark the routine as complete
+  void _finish()
+  {
+    cancel();
+    _succeeded = true;
+  }
+
+  /// Mark the routine as having given up
+  void _abandon()
+  {
+    cancel();
+  }
+
+  int _step = Done;
+  rmf_traffic::Time _now;
+
+private:
+
+  void _set_timeout(rmf_traffic::Duration timeout)
+  {
+    _deadline = timeout == rmf_traffic::Duration::max() ?
+      rmf_traffic::Time::max() : _now + timeout;
+  }
+
+  bool _succeeded = false;
+  std::string _awaited_task_id;
+  rmf_traffic::Time _deadline = rmf_traffic::Time::max();
+};
+
+//==============================================================================
+/// A resumable routine that carries out one command for one robot.
+///
+/// Tasks are stackless coroutines: everything a task needs to remember across
+/// a suspension is a member of the task object, and resume() re-enters the
+/// routine at the step where it last suspended. A task suspends by calling one
+/// of the _await_*() functions and then returning from its _run(). Robot
+/// handles keep their task objects as members, so starting a command allocates
+/// nothing and an idle task costs only its frame. The routine body is bound at
+/// compile time through Derived::_run, so resuming is not a virtual call.
+template<typename Derived>
+class RobotTask : public TaskFrame
+{
+public:
+
+  /// Start the routine from the beginning, abandoning any earlier run
+  void start(rmf_traffic::Time now)
+  {
+    cancel();
+    _step = Begin;
+    resume(TaskEvent::Start, nullptr, now);
+  }
+
+  /// Resume the routine. The state is only provided for StateArrived and
+  /// AckReceived events.
+  void resume(
+    TaskEvent event,
+    const messages::RobotState* state,
+    rmf_traffic::Time now)
+  {
+    if (done())
+      return;
+
+    _now = now;
+    static_cast<Derived*>(this)->_run(event, state);
+  }
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__ROBOT_TASK_HPP
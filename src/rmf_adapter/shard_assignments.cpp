@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include "shard_assignments.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+/// Finalizer of splitmix64, used to spread the ring points of a shard
+uint64_t mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+//==============================================================================
+constexpr std::size_t PointsPerShard = 64;
+
+} // anonymous namespace
+
+//==============================================================================
+ShardRing::ShardRing(
+  const std::set<uint32_t>& shards,
+  std::size_t points_per_shard)
+{
+  _points.reserve(shards.size() * points_per_shard);
+  for (const uint32_t shard : shards)
+  {
+    for (std::size_t i = 0; i < points_per_shard; ++i)
+      _points.push_back({mix((uint64_t(shard) << 32) | i), shard});
+  }
+
+  std::sort(_points.begin(), _points.end());
+}
+
+//==============================================================================
+uint32_t ShardRing::owner(const std::string& key) const
+{
+  const uint64_t h = hash(key);
+  auto it = std::lower_bound(
+    _points.begin(), _points.end(), std::make_pair(h, uint32_t(0)));
+  if (it == _points.end())
+    it = _points.begin();
+
+  return it->second;
+}
+
+//==============================================================================
+bool ShardRing::empty() const
+{
+  return _points.empty();
+}
+
+//==============================================================================
+uint64_t ShardRing::hash(const std::string& key)
+{
+  // FNV-1a, which unlike std::hash gives the same result in every process
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const char c : key)
+  {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ULL;
+  }
+
+  return mix(h);
+}
+
+//==============================================================================
+ShardAssignments::ShardAssignments(
+  uint32_t shard_id,
+  rmf_traffic::Duration settle_time,
+  rmf_traffic::Time now)
+: _shard_id(shard_id),
+  _settle_time(settle_time),
+  _settled_at(now + settle_time),
+  _members({shard_id}),
+  _ring(_members, PointsPerShard)
+{
+  // Nothing else to initialize
+}
+
+//==============================================================================
+bool ShardAssignments::set_members(
+  std::set<uint32_t> members,
+  rmf_traffic::Time now)
+{
+  members.insert(_shard_id);
+  if (members == _members)
+    return false;
+
+  _members = std::move(members);
+  _ring = ShardRing(_members, PointsPerShard);
+  _settled_at = now + _settle_time;
+  return true;
+}
+
+//==============================================================================
+std::vector<std::string> ShardAssignments::set_claims(
+  uint32_t peer,
+  std::vector<std::string> robots)
+{
+  std::vector<std::string> conflicts;
+  if (peer == _shard_id)
+    return conflicts;
+
+  auto& claims = _peer_claims[peer];
+  for (const auto& robot : claims)
+  {
+    const auto it = _claimed_by.find(robot);
+    if (it != _claimed_by.end() && it->second == peer)
+      _claimed_by.erase(it);
+  }
+
+  claims = std::move(robots);
+  for (const auto& robot : claims)
+  {
+    if (_own.count(robot) != 0)
+      conflicts.push_back(robot);
+    else
+      _claimed_by[robot] = peer;
+  }
+
+  return conflicts;
+}
+
+//==============================================================================
+bool ShardAssignments::settled(rmf_traffic::Time now) const
+{
+  if (now < _settled_at)
+    return false;
+
+  for (const uint32_t member : _members)
+  {
+    if (member != _shard_id && _peer_claims.count(member) == 0)
+      return false;
+  }
+
+  return true;
+}
+
+//==============================================================================
+rmf_utils::optional<uint32_t> ShardAssignments::owner(
+  const std::string& robot_name,
+  rmf_traffic::Time now)
+{
+  if (_own.count(robot_name) != 0)
+    return _shard_id;
+
+  // The claims of a shard that has left are kept, since its announcement may
+  // arrive before it is discovered, but they no longer hold its robots.
+  const auto claimed = _claimed_by.find(robot_name);
+  if (claimed != _claimed_by.end() && _members.count(claimed->second) != 0)
+    return claimed->second;
+
+  if (!settled(now))
+    return rmf_utils::nullopt;
+
+  const uint32_t owner = _ring.owner(robot_name);
+  if (owner == _shard_id)
+  {
+    _own.insert(robot_name);
+    _claims.push_back(robot_name);
+  }
+
+  return owner;
+}
+
+//==============================================================================
+const std::vector<std::string>& ShardAssignments::claims() const
+{
+  return _claims;
+}
+
+//==============================================================================
+uint32_t ShardAssignments::shard_id() const
+{
+  return _shard_id;
+}
+
+//==============================================================================
+const std::set<uint32_t>& ShardAssignments::members() const
+{
+  return _members;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__SHARD_ASSIGNMENTS_HPP
+#define SRC__RMF_ADAPTER__SHARD_ASSIGNMENTS_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <rmf_traffic/Time.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// A consistent hash ring over shard ids. Every shard is placed on the ring
+/// many times, so that adding or removing a shard only moves the robots of
+/// the neighbouring ring segments. The hash is fixed, so every process of a
+/// fleet computes the same owner for a robot.
+class ShardRing
+{
+public:
+
+  ShardRing(const std::set<uint32_t>& shards, std::size_t points_per_shard);
+
+  /// Get the shard that owns the key. The ring must not be empty.
+  uint32_t owner(const std::string& key) const;
+
+  bool empty() const;
+
+  static uint64_t hash(const std::string& key);
+
+private:
+  std::vector<std::pair<uint64_t, uint32_t>> _points;
+};
+
+//==============================================================================
+/// The rules that decide which shard of a fleet is responsible for a robot,
+/// kept apart from the ROS graph so that every interleaving of shards joining
+/// and leaving can be replayed.
+///
+/// A robot that a live shard has claimed stays with that shard, since the
+/// fleet adapter cannot deregister robots. Any other robot is placed on the
+/// ring over the live shards, but only once this shard has settled: its view
+/// of the membership has been stable for the settle time, and every live peer
+/// has told it which robots it claims. Until then such robots are undecided,
+/// and neither side of a join can claim a robot that the other already has.
+class ShardAssignments
+{
+public:
+
+  ShardAssignments(
+    uint32_t shard_id,
+    rmf_traffic::Duration settle_time,
+    rmf_traffic::Time now);
+
+  /// Set the shards that are alive. Returns true if the membership changed,
+  /// in which case the settle time starts over. Robots claimed by shards that
+  /// have left go back on the ring.
+  bool set_members(std::set<uint32_t> members, rmf_traffic::Time now);
+
+  /// Replace the robots that a peer claims. Returns the robots that this
+  /// shard has claimed as well, which should never happen while the shards
+  /// agree on the membership.
+  std::vector<std::string> set_claims(
+    uint32_t peer,
+    std::vector<std::string> robots);
+
+  /// True once undecided robots can be placed on the ring
+  bool settled(rmf_traffic::Time now) const;
+
+  /// Get the shard that is responsible for a robot, claiming it if that is
+  /// this shard. Returns nullopt while the robot is undecided.
+  rmf_utils::optional<uint32_t> owner(
+    const std::string& robot_name,
+    rmf_traffic::Time now);
+
+  /// The robots that this shard has claimed, in the order they were claimed.
+  /// Claims are never taken back, so the list only grows.
+  const std::vector<std::string>& claims() const;
+
+  uint32_t shard_id() const;
+
+  const std::set<uint32_t>& members() const;
+
+private:
+  uint32_t _shard_id;
+  rmf_traffic::Duration _settle_time;
+  rmf_traffic::Time _settled_at;
+  std::set<uint32_t> _members;
+  ShardRing _ring;
+
+  std::unordered_map<uint32_t, std::vector<std::string>> _peer_claims;
+  std::unordered_map<std::string, uint32_t> _claimed_by;
+  std::unordered_set<std::string> _own;
+  std::vector<std::string> _claims;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__SHARD_ASSIGNMENTS_HPP
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cctype>
+#include <algorithm>
+
+#include "shard_coordinator.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+namespace {
+//==============================================================================
+std::string shard_prefix(const std::string& fleet_name)
+{
+  std::string prefix;
+  prefix.reserve(fleet_name.size() + 7);
+  for (const char c : fleet_name)
+    prefix.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+
+  prefix += "_shard_";
+  return prefix;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+ShardCoordinator::ShardCoordinator(
+  rclcpp::Node& node,
+  const std::string& fleet_name,
+  uint32_t shard_id,
+  rmf_traffic::Duration settle_time)
+: _node(&node),
+  _prefix(shard_prefix(fleet_name)),
+  _presence(
+    std::make_shared<rclcpp::Node>(_prefix + std::to_string(shard_id))),
+  _assignments(shard_id, settle_time, std::chrono::steady_clock::now()),
+  _announced(0)
+{
+  // Every shard keeps its latest list, so that a shard that joins later
+  // receives the claims of all of its peers.
+  const auto qos = rclcpp::QoS(1).reliable().transient_local();
+  _claims_publisher = _node->create_publisher<ShardClaims>(
+    _prefix + "claims", qos);
+
+  _claims_subscription = _node->create_subscription<ShardClaims>(
+    _prefix + "claims", qos,
+    [this](ShardClaims::SharedPtr msg)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto conflicts =
+        _assignments.set_claims(msg->shard_id, std::move(msg->robots));
+
+      for (const auto& robot : conflicts)
+      {
+        RCLCPP_ERROR(
+          _node->get_logger(),
+          "Robot [%s] is claimed by both shard %u and this shard %u",
+          robot.c_str(), msg->shard_id, _assignments.shard_id());
+      }
+    });
+
+  refresh();
+
+  // Peers cannot settle until they have heard from this shard, even if it
+  // has nothing to claim yet
+  std::lock_guard<std::mutex> lock(_mutex);
+  _announce();
+}
+
+//==============================================================================
+bool ShardCoordinator::refresh()
+{
+  std::set<uint32_t> members;
+  for (const auto& full_name : _node->get_node_names())
+  {
+    const auto slash = full_name.rfind('/');
+    const auto name = slash == std::string::npos ?
+      full_name : full_name.substr(slash + 1);
+    if (name.compare(0, _prefix.size(), _prefix) != 0)
+      continue;
+
+    const auto id = name.substr(_prefix.size());
+    const auto is_digit = [](char c)
+      {
+        return std::isdigit(static_cast<unsigned char>(c)) != 0;
+      };
+    if (id.empty() || !std::all_of(id.begin(), id.end(), is_digit))
+      continue;
+
+    members.insert(static_cast<uint32_t>(std::stoul(id)));
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_assignments.claims().size() != _announced)
+    _announce();
+
+  return _assignments.set_members(
+    std::move(members), std::chrono::steady_clock::now());
+}
+
+//==============================================================================
+bool ShardCoordinator::owns(
+  const std::string& robot_name,
+  rmf_traffic::Time now)
+{
+  const auto shard = owner(robot_name, now);
+  return shard && *shard == shard_id();
+}
+
+//==============================================================================
+rmf_utils::optional<uint32_t> ShardCoordinator::owner(
+  const std::string& robot_name,
+  rmf_traffic::Time now)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _assignments.owner(robot_name, now);
+}
+
+//==============================================================================
+bool ShardCoordinator::settled(rmf_traffic::Time now) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _assignments.settled(now);
+}
+
+//==============================================================================
+uint32_t ShardCoordinator::shard_id() const
+{
+  return _assignments.shard_id();
+}
+
+//==============================================================================
+std::set<uint32_t> ShardCoordinator::members() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _assignments.members();
+}
+
+//==============================================================================
+void ShardCoordinator::_announce()
+{
+  ShardClaims msg;
+  msg.shard_id = _assignments.shard_id();
+  msg.robots = _assignments.claims();
+  _claims_publisher->publish(msg);
+  _announced = msg.robots.size();
+}
+
+} // namespace rmf
+} // namespace free_fleet
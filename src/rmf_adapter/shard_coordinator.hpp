@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__SHARD_COORDINATOR_HPP
+#define SRC__RMF_ADAPTER__SHARD_COORDINATOR_HPP
+
+#include <set>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmf_traffic/Time.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <free_fleet_ros2/msg/shard_claims.hpp>
+
+#include "shard_assignments.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Decides which robots of a sharded fleet this process is responsible for.
+///
+/// Each adapter process of the fleet announces itself with a ROS node named
+/// <fleet>_shard_<id>, and discovers its peers by looking for nodes with the
+/// same prefix. Every shard also publishes the robots it has claimed on the
+/// <fleet>_shard_claims topic. See ShardAssignments for how those are turned
+/// into a single owner per robot. While a shard has not settled, robots that
+/// nobody has claimed are not owned by anyone, and their states are dropped
+/// until the next one arrives after the shards agree.
+///
+/// A restarted shard must stay down longer than the DDS liveliness lease, so
+/// its peers notice it leaving and take over its robots.
+class ShardCoordinator
+{
+public:
+
+  using ShardClaims = free_fleet_ros2::msg::ShardClaims;
+
+  ShardCoordinator(
+    rclcpp::Node& node,
+    const std::string& fleet_name,
+    uint32_t shard_id,
+    rmf_traffic::Duration settle_time);
+
+  /// Refresh the set of live shards from the ROS graph, and announce the
+  /// robots claimed since the last refresh. Returns true if the membership
+  /// changed.
+  bool refresh();
+
+  /// True if this process is responsible for the robot
+  bool owns(const std::string& robot_name, rmf_traffic::Time now);
+
+  /// Get the shard that is responsible for the robot, or nullopt if that is
+  /// not decided yet
+  rmf_utils::optional<uint32_t> owner(
+    const std::string& robot_name,
+    rmf_traffic::Time now);
+
+  bool settled(rmf_traffic::Time now) const;
+
+  uint32_t shard_id() const;
+
+  std::set<uint32_t> members() const;
+
+private:
+
+  void _announce();
+
+  rclcpp::Node* _node;
+  std::string _prefix;
+
+  /// Announces this shard to its peers
+  std::shared_ptr<rclcpp::Node> _presence;
+
+  rclcpp::Publisher<ShardClaims>::SharedPtr _claims_publisher;
+  rclcpp::Subscription<ShardClaims>::SharedPtr _claims_subscription;
+
+  /// States are filtered on the ingestion thread while claims arrive on the
+  /// executor
+  mutable std::mutex _mutex;
+  ShardAssignments _assignments;
+  std::size_t _announced;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__SHARD_COORDINATOR_HPP
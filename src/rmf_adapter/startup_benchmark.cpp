@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Replays the startup of the full control adapter against synthetic
+// navigation graphs of increasing size, and prints how long each phase takes.
+//
+// Usage: startup_benchmark [--levels L] [--repeat R] [--dds-domain D]
+//                          [waypoints...]
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include <rmf_fleet_adapter/agv/Adapter.hpp>
+#include <rmf_fleet_adapter/agv/parse_graph.hpp>
+
+#include <free_fleet_cyclonedds/CycloneDDSMiddleware.hpp>
+
+#include "startup_profile.hpp"
+#include "state_validator.hpp"
+
+namespace {
+
+//==============================================================================
+struct Options
+{
+  std::vector<std::size_t> waypoints;
+  std::size_t levels = 1;
+  std::size_t repeat = 3;
+  int dds_domain = -1;
+};
+
+//==============================================================================
+/// Write a navigation graph in the format that parse_graph reads. Every level
+/// is a square grid of named waypoints with bidirectional lanes between
+/// neighbours, which is about as dense as real warehouse graphs get.
+void write_grid_graph(
+  const std::string& path,
+  std::size_t waypoints,
+  std::size_t levels)
+{
+  const std::size_t per_level = (waypoints + levels - 1) / levels;
+  const auto side = static_cast<std::size_t>(
+    std::ceil(std::sqrt(static_cast<double>(per_level))));
+
+  std::ofstream file(path);
+  file << "building_name: startup_benchmark\nlevels:\n";
+  for (std::size_t l = 0; l < levels; ++l)
+  {
+    file << "  L" << l << ":\n    vertices:\n";
+    for (std::size_t i = 0; i < per_level; ++i)
+    {
+      file << "    - [" << 2.0 * (i % side) << ", " << 2.0 * (i / side)
+           << ", {name: L" << l << "_" << i << "}]\n";
+    }
+
+    file << "    lanes:\n";
+    for (std::size_t i = 0; i < per_level; ++i)
+    {
+      const std::size_t right = i + 1;
+      if (right % side != 0 && right < per_level)
+      {
+        file << "    - [" << i << ", " << right << ", {}]\n";
+        file << "    - [" << right << ", " << i << ", {}]\n";
+      }
+
+      const std::size_t down = i + side;
+      if (down < per_level)
+      {
+        file << "    - [" << i << ", " << down << ", {}]\n";
+        file << "    - [" << down << ", " << i << ", {}]\n";
+      }
+    }
+  }
+}
+
+//==============================================================================
+/// The same traits that the adapter falls back on when no parameters are set
+rmf_traffic::agv::VehicleTraits default_traits()
+{
+  return rmf_traffic::agv::VehicleTraits{
+    {0.7, 0.5},
+    {0.3, 1.5},
+    rmf_traffic::Profile{
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Circle>(0.5),
+      rmf_traffic::geometry::make_final_convex<
+        rmf_traffic::geometry::Circle>(1.5)
+    }
+  };
+}
+
+//==============================================================================
+bool parse_options(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--levels" && has_value)
+      options.levels = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--repeat" && has_value)
+      options.repeat = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--dds-domain" && has_value)
+      options.dds_domain = std::atoi(argv[++i]);
+    else if (!arg.empty() && arg[0] != '-')
+      options.waypoints.push_back(std::strtoul(arg.c_str(), nullptr, 10));
+    else
+      return false;
+  }
+
+  if (options.waypoints.empty())
+    options.waypoints = {1000, 10000, 100000};
+
+  return options.levels > 0 && options.repeat > 0;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    std::fprintf(
+      stderr,
+      "Usage: %s [--levels L] [--repeat R] [--dds-domain D] [waypoints...]\n",
+      argv[0]);
+    return 1;
+  }
+
+  rclcpp::init(argc, argv);
+  const auto adapter =
+    rmf_fleet_adapter::agv::Adapter::make("startup_benchmark");
+  if (!adapter)
+    return 1;
+
+  const auto traits = default_traits();
+  const std::string graph_file =
+    "/tmp/free_fleet_startup_benchmark_" + std::to_string(getpid()) + ".yaml";
+
+  for (const std::size_t waypoints : options.waypoints)
+  {
+    write_grid_graph(graph_file, waypoints, options.levels);
+
+    for (std::size_t r = 0; r < options.repeat; ++r)
+    {
+      // Every run registers its own fleet, just like a fresh adapter would.
+      const std::string fleet_name = "benchmark_" + std::to_string(waypoints)
+        + "_" + std::to_string(r);
+
+      free_fleet::rmf::StartupProfile startup;
+      const auto graph =
+        rmf_fleet_adapter::agv::parse_graph(graph_file, traits);
+      startup.mark("parse_graph");
+
+      std::ostringstream discard;
+      free_fleet::rmf::print_waypoint_names(discard, fleet_name, graph);
+      startup.mark("print_waypoints");
+
+      const auto fleet = adapter->add_fleet(fleet_name, traits, graph);
+      startup.mark("add_fleet");
+
+      const free_fleet::rmf::StateValidator validator(graph, 10.0);
+      startup.mark("state_validator");
+
+      if (options.dds_domain >= 0)
+      {
+        const auto middleware =
+          free_fleet::cyclonedds::CycloneDDSMiddleware::make_server(
+          options.dds_domain, fleet_name);
+        startup.mark("make_server");
+      }
+
+      std::printf(
+        "waypoints=%zu levels=%zu run=%zu%s\n", graph.num_waypoints(),
+        options.levels, r, startup.report().c_str());
+    }
+  }
+
+  std::remove(graph_file.c_str());
+  rclcpp::shutdown();
+  return 0;
+}
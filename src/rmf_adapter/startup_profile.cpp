@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "startup_profile.hpp"
+
+#include <cstdio>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+StartupProfile::StartupProfile()
+: _start(Clock::now()),
+  _last(_start)
+{}
+
+//==============================================================================
+void StartupProfile::mark(std::string name)
+{
+  const auto now = Clock::now();
+  _phases.push_back(Phase{std::move(name), now - _last});
+  _last = now;
+}
+
+//==============================================================================
+auto StartupProfile::phases() const -> const std::vector<Phase>&
+{
+  return _phases;
+}
+
+//==============================================================================
+auto StartupProfile::total() const -> Clock::duration
+{
+  return _last - _start;
+}
+
+//==============================================================================
+std::string StartupProfile::report() const
+{
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  const double total_ms = Milliseconds(total()).count();
+
+  std::string output;
+  char line[128];
+  for (const auto& phase : _phases)
+  {
+    const double ms = Milliseconds(phase.duration).count();
+    std::snprintf(
+      line, sizeof(line), "\n -- %-24s %10.3f ms %5.1f%%",
+      phase.name.c_str(), ms, total_ms > 0.0 ? 100.0 * ms / total_ms : 0.0);
+    output += line;
+  }
+
+  std::snprintf(line, sizeof(line), "\n -- %-24s %10.3f ms", "total", total_ms);
+  output += line;
+  return output;
+}
+
+//==============================================================================
+void print_waypoint_names(
+  std::ostream& os,
+  const std::string& fleet_name,
+  const rmf_traffic::agv::Graph& graph)
+{
+  std::string output =
+    "The fleet [" + fleet_name + "] has the following named waypoints:\n";
+  for (const auto& key : graph.keys())
+  {
+    output += " -- ";
+    output += key.first;
+    output += '\n';
+  }
+
+  os << output << std::flush;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__STARTUP_PROFILE_HPP
+#define SRC__RMF_ADAPTER__STARTUP_PROFILE_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <rmf_traffic/agv/Graph.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Splits the startup of an adapter into named phases and measures how long
+/// each of them takes. The first phase begins when the profile is created,
+/// and every call to mark() ends the phase in progress.
+class StartupProfile
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Phase
+  {
+    std::string name;
+    Clock::duration duration;
+  };
+
+  StartupProfile();
+
+  /// End the phase in progress and give it a name
+  void mark(std::string name);
+
+  const std::vector<Phase>& phases() const;
+
+  /// Time from the creation of the profile until the last mark
+  Clock::duration total() const;
+
+  /// One line per phase with its duration and share of the total
+  std::string report() const;
+
+private:
+  Clock::time_point _start;
+  Clock::time_point _last;
+  std::vector<Phase> _phases;
+};
+
+//==============================================================================
+/// Write the named waypoints of a fleet's graph, one per line. The output is
+/// assembled first and written in one go, since flushing after every name
+/// dominates startup for large graphs.
+void print_waypoint_names(
+  std::ostream& os,
+  const std::string& fleet_name,
+  const rmf_traffic::agv::Graph& graph);
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__STARTUP_PROFILE_HPP
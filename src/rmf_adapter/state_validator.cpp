@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <limits>
+#include <algorithm>
+
+#include "state_validator.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+double StateValidator::Record::rejection_rate() const
+{
+  const uint64_t total = accepted + rejected;
+  return total == 0 ? 0.0 : static_cast<double>(rejected) / total;
+}
+
+//==============================================================================
+StateValidator::StateValidator(
+  const rmf_traffic::agv::Graph& graph,
+  double margin)
+{
+  for (std::size_t i = 0; i < graph.num_waypoints(); ++i)
+  {
+    const auto& wp = graph.get_waypoint(i);
+    const auto p = wp.get_location();
+    const auto insertion =
+      _level_index.insert({wp.get_map_name(), _level_bounds.size()});
+    if (insertion.second)
+      _level_bounds.push_back(Bounds{p[0], p[1], p[0], p[1]});
+
+    auto& bounds = _level_bounds[insertion.first->second];
+    bounds.min_x = std::min(bounds.min_x, p[0]);
+    bounds.min_y = std::min(bounds.min_y, p[1]);
+    bounds.max_x = std::max(bounds.max_x, p[0]);
+    bounds.max_y = std::max(bounds.max_y, p[1]);
+  }
+
+  for (auto& bounds : _level_bounds)
+  {
+    bounds.min_x -= margin;
+    bounds.min_y -= margin;
+    bounds.max_x += margin;
+    bounds.max_y += margin;
+  }
+}
+
+//==============================================================================
+std::size_t StateValidator::validate(
+  const std::vector<messages::RobotState>& states,
+  std::vector<uint8_t>& accepted)
+{
+  const std::size_t n = states.size();
+  _x.resize(n);
+  _y.resize(n);
+  _yaw.resize(n);
+  _min_x.resize(n);
+  _min_y.resize(n);
+  _max_x.resize(n);
+  _max_y.resize(n);
+  accepted.resize(n);
+
+  // Gather the poses and the bounds of their levels into flat arrays. A level
+  // that the graph does not know gets empty bounds, which nothing can pass.
+  constexpr double inf = std::numeric_limits<double>::infinity();
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const auto& loc = states[i].location;
+    _x[i] = loc.x;
+    _y[i] = loc.y;
+    _yaw[i] = loc.yaw;
+
+    const auto it = _level_index.find(loc.level_name);
+    if (it == _level_index.end())
+    {
+      _min_x[i] = inf;
+      _min_y[i] = inf;
+      _max_x[i] = -inf;
+      _max_y[i] = -inf;
+      continue;
+    }
+
+    const auto& bounds = _level_bounds[it->second];
+    _min_x[i] = bounds.min_x;
+    _min_y[i] = bounds.min_y;
+    _max_x[i] = bounds.max_x;
+    _max_y[i] = bounds.max_y;
+  }
+
+  // Branch-free so that the compiler can vectorize it. Every comparison with
+  // NaN is false, so NaN positions fail the bounds test, and subtracting an
+  // infinite or NaN yaw from itself does not give zero.
+  const double* x = _x.data();
+  const double* y = _y.data();
+  const double* yaw = _yaw.data();
+  const double* min_x = _min_x.data();
+  const double* min_y = _min_y.data();
+  const double* max_x = _max_x.data();
+  const double* max_y = _max_y.data();
+  uint8_t* ok = accepted.data();
+  std::size_t num_accepted = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    ok[i] = static_cast<uint8_t>(
+      (x[i] >= min_x[i]) & (x[i] <= max_x[i])
+      & (y[i] >= min_y[i]) & (y[i] <= max_y[i])
+      & (yaw[i] - yaw[i] == 0.0));
+    num_accepted += ok[i];
+  }
+
+  const std::size_t num_rejected = n - num_accepted;
+  _quarantined += num_rejected;
+  return num_rejected;
+}
+
+//==============================================================================
+const StateValidator::Record& StateValidator::record(
+  std::size_t slot,
+  bool accepted)
+{
+  if (slot >= _records.size())
+    _records.resize(slot + 1);
+
+  auto& record = _records[slot];
+  if (accepted)
+    ++record.accepted;
+  else
+    ++record.rejected;
+
+  return record;
+}
+
+//==============================================================================
+uint64_t StateValidator::quarantined() const
+{
+  return _quarantined;
+}
+
+} // namespace rmf
+} // namespace free_fleet
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__STATE_VALIDATOR_HPP
+#define SRC__RMF_ADAPTER__STATE_VALIDATOR_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <rmf_traffic/agv/Graph.hpp>
+
+#include <free_fleet/messages/RobotState.hpp>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Screens incoming robot states before they reach the fleet adapter. A state
+/// is rejected if its pose is not finite, if it is on a level that the
+/// navigation graph does not know about, or if it lies outside the bounding
+/// box of that level's waypoints grown by a margin.
+class StateValidator
+{
+public:
+
+  /// Rejection counts of a single robot
+  struct Record
+  {
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+
+    /// Fraction of this robot's states that were rejected
+    double rejection_rate() const;
+  };
+
+  StateValidator(const rmf_traffic::agv::Graph& graph, double margin);
+
+  /// Check every state of a drain in one pass. After this returns,
+  /// accepted[i] is 1 if states[i] may be used and 0 if it must be dropped.
+  /// Returns the number of rejected states.
+  std::size_t validate(
+    const std::vector<messages::RobotState>& states,
+    std::vector<uint8_t>& accepted);
+
+  /// Count the outcome of a validated state against the robot in a slot.
+  /// Returns the robot's record after counting.
+  const Record& record(std::size_t slot, bool accepted);
+
+  /// Total number of states that have been quarantined so far
+  uint64_t quarantined() const;
+
+private:
+
+  struct Bounds
+  {
+    double min_x;
+    double min_y;
+    double max_x;
+    double max_y;
+  };
+
+  std::unordered_map<std::string, std::size_t> _level_index;
+  std::vector<Bounds> _level_bounds;
+  std::vector<Record> _records;
+  uint64_t _quarantined = 0;
+
+  // Scratch space that is reused between drains
+  std::vector<double> _x;
+  std::vector<double> _y;
+  std::vector<double> _yaw;
+  std::vector<double> _min_x;
+  std::vector<double> _min_y;
+  std::vector<double> _max_x;
+  std::vector<double> _max_y;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__STATE_VALIDATOR_HPP
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "trip_stops.hpp"
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+TripStops& TripStops::operator+=(const TripStops& other)
+{
+  trips += other.trips;
+  stops += other.stops;
+  max_stops = std::max(max_stops, other.max_stops);
+  return *this;
+}
+
+//==============================================================================
+double TripStops::stops_per_trip() const
+{
+  return trips == 0 ? 0.0 :
+    static_cast<double>(stops) / static_cast<double>(trips);
+}
+
+//==============================================================================
+TripStopCounter::TripStopCounter(double speed_threshold)
+: _speed_threshold(speed_threshold)
+{}
+
+//==============================================================================
+void TripStopCounter::begin_trip()
+{
+  _in_trip = true;
+  _moving = false;
+  _has_position = false;
+  _stops = 0;
+}
+
+//==============================================================================
+bool TripStopCounter::in_trip() const
+{
+  return _in_trip;
+}
+
+//==============================================================================
+void TripStopCounter::observe(double x, double y, Clock::time_point time)
+{
+  if (!_in_trip)
+    return;
+
+  if (!_has_position)
+  {
+    _has_position = true;
+    _x = x;
+    _y = y;
+    _time = time;
+    return;
+  }
+
+  // States that arrive in a burst say nothing about the speed.
+  const double dt = std::chrono::duration<double>(time - _time).count();
+  if (dt < 1e-3)
+    return;
+
+  const double speed = std::hypot(x - _x, y - _y) / dt;
+  _x = x;
+  _y = y;
+  _time = time;
+
+  const bool moving = speed > _speed_threshold;
+  if (_moving && !moving)
+    ++_stops;
+
+  _moving = moving;
+}
+
+//==============================================================================
+uint32_t TripStopCounter::end_trip()
+{
+  if (!_in_trip)
+    return 0;
+
+  // Stopping at the destination is the whole point of the trip.
+  uint32_t stops = _stops;
+  if (stops > 0 && !_moving)
+    --stops;
+
+  _in_trip = false;
+  ++_totals.trips;
+  _totals.stops += stops;
+  _totals.max_stops = std::max(_totals.max_stops, stops);
+  return stops;
+}
+
+//==============================================================================
+const TripStops& TripStopCounter::totals() const
+{
+  return _totals;
+}
+
+} // namespace rmf
+} // namespace free_fleet
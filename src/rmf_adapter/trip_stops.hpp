@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_ADAPTER__TRIP_STOPS_HPP
+#define SRC__RMF_ADAPTER__TRIP_STOPS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+namespace free_fleet {
+namespace rmf {
+
+//==============================================================================
+/// Totals of the finished trips of one or more robots
+struct TripStops
+{
+  /// Number of finished trips
+  uint64_t trips = 0;
+
+  /// Total number of stops of all finished trips
+  uint64_t stops = 0;
+
+  /// The most stops that any finished trip had
+  uint32_t max_stops = 0;
+
+  /// Add the totals of another robot
+  TripStops& operator+=(const TripStops& other);
+
+  /// Average number of stops per finished trip
+  double stops_per_trip() const;
+};
+
+//==============================================================================
+/// Counts how often a robot comes to a standstill on its way to the end of a
+/// path, be it for a wait in its plan, a stop during a negotiation or a door
+/// that is still closed. The speed of the robot is worked out from the
+/// positions that it reports.
+class TripStopCounter
+{
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+  /// speed_threshold is the speed in m/s below which the robot counts as
+  /// standing still
+  TripStopCounter(double speed_threshold = 0.02);
+
+  /// Start counting the stops of a new trip
+  void begin_trip();
+
+  /// True between begin_trip() and end_trip()
+  bool in_trip() const;
+
+  /// Note a position that the robot reported. Only a robot that was moving
+  /// before can come to a stop.
+  void observe(double x, double y, Clock::time_point time);
+
+  /// Finish the current trip. The robot standing still at its destination
+  /// does not count as a stop. Returns the number of stops of the trip.
+  uint32_t end_trip();
+
+  /// Totals of all finished trips
+  const TripStops& totals() const;
+
+private:
+  double _speed_threshold;
+  bool _in_trip = false;
+  bool _moving = false;
+  bool _has_position = false;
+  double _x = 0.0;
+  double _y = 0.0;
+  Clock::time_point _time;
+  uint32_t _stops = 0;
+  TripStops _totals;
+};
+
+} // namespace rmf
+} // namespace free_fleet
+
+#endif // SRC__RMF_ADAPTER__TRIP_STOPS_HPP
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "command_outbox.hpp"
+
+using free_fleet::messages::ModeRequest;
+using free_fleet::messages::NavigationRequest;
+using free_fleet::rmf::CommandOutbox;
+
+namespace {
+
+//==============================================================================
+/// Records the task ids of the commands in the order they were sent
+class RecordingMiddleware : public free_fleet::transport::Middleware
+{
+public:
+
+  std::vector<std::string> sent;
+
+  void send_state(const free_fleet::messages::RobotState&) final {}
+
+  std::vector<free_fleet::messages::RobotState> read_states() final
+  {
+    return {};
+  }
+
+  void send_mode_request(const ModeRequest& request) final
+  {
+    sent.push_back(request.task_id);
+  }
+
+  rmf_utils::optional<ModeRequest> read_mode_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_navigation_request(const NavigationRequest& request) final
+  {
+    sent.push_back(request.task_id);
+  }
+
+  rmf_utils::optional<NavigationRequest> read_navigation_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_relocalization_request(
+    const free_fleet::messages::RelocalizationRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::RelocalizationRequest>
+  read_relocalization_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+};
+
+//==============================================================================
+void queue_navigation(
+  CommandOutbox& outbox,
+  std::size_t robot,
+  const std::string& task_id,
+  bool commit)
+{
+  auto loan = outbox.loan_navigation_request(robot);
+  loan.request().robot_name = "robot";
+  loan.request().task_id = task_id;
+  if (commit)
+    loan.commit();
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Only committed loans change what gets sent")
+{
+  const auto middleware = std::make_shared<RecordingMiddleware>();
+  CommandOutbox outbox(middleware);
+  const std::size_t robot = outbox.add_robot();
+
+  queue_navigation(outbox, robot, "1", true);
+  queue_navigation(outbox, robot, "abandoned", false);
+  CHECK(outbox.flush() == 1);
+  CHECK(middleware->sent == std::vector<std::string>{"1"});
+
+  WHEN("A committed request is replaced before the flush")
+  {
+    queue_navigation(outbox, robot, "2", true);
+    queue_navigation(outbox, robot, "3", true);
+    queue_navigation(outbox, robot, "abandoned", false);
+    CHECK(outbox.flush() == 1);
+    CHECK(middleware->sent.back() == "3");
+  }
+
+  WHEN("Nothing was committed since the last flush")
+  {
+    queue_navigation(outbox, robot, "abandoned", false);
+    CHECK(outbox.flush() == 0);
+  }
+
+  WHEN("A loan is committed twice")
+  {
+    {
+      auto loan = outbox.loan_navigation_request(robot);
+      loan.request().task_id = "4";
+      loan.commit();
+      loan.commit();
+    }
+
+    CHECK(outbox.flush() == 1);
+    CHECK(middleware->sent.back() == "4");
+  }
+
+  WHEN("Both kinds of requests are queued")
+  {
+    {
+      auto loan = outbox.loan_mode_request(robot);
+      loan.request().task_id = "mode";
+      loan.commit();
+    }
+    queue_navigation(outbox, robot, "navigation", true);
+
+    THEN("They are sent in the order they were committed")
+    {
+      CHECK(outbox.flush() == 2);
+      const auto& sent = middleware->sent;
+      REQUIRE(sent.size() >= 2);
+      CHECK(sent[sent.size() - 2] == "mode");
+      CHECK(sent.back() == "navigation");
+    }
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "dds_transport.hpp"
+
+using free_fleet::rmf::DdsTransport;
+using free_fleet::rmf::dds_transport_applies;
+using free_fleet::rmf::parse_dds_transport;
+
+//==============================================================================
+SCENARIO("Transport names are parsed")
+{
+  CHECK(parse_dds_transport("") == DdsTransport::Default);
+  CHECK(parse_dds_transport("udp") == DdsTransport::Default);
+  CHECK(parse_dds_transport("loopback") == DdsTransport::Loopback);
+  CHECK(parse_dds_transport("shm") == DdsTransport::SharedMemory);
+  CHECK_FALSE(parse_dds_transport("tcp"));
+}
+
+//==============================================================================
+SCENARIO("A Cyclone ROS 2 middleware on the same domain keeps its config")
+{
+  CHECK_FALSE(dds_transport_applies("rmw_cyclonedds_cpp", 0, 0));
+  CHECK(dds_transport_applies("rmw_cyclonedds_cpp", 0, 42));
+  CHECK(dds_transport_applies("rmw_fastrtps_cpp", 0, 0));
+  CHECK(dds_transport_applies("rmw_connextdds", 7, 7));
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "facility_requests.hpp"
+
+using free_fleet::rmf::FacilityEvent;
+using free_fleet::rmf::FacilityLookahead;
+
+namespace {
+
+//==============================================================================
+FacilityEvent door(std::size_t plan_index, rmf_traffic::Time arrival)
+{
+  return FacilityEvent{
+    FacilityEvent::Kind::Door, plan_index, arrival, "door", ""};
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Doors are requested once the robot is within the lead time")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time start = rmf_traffic::Time(1000s);
+  const rmf_traffic::Duration lead_time = 10s;
+
+  FacilityLookahead lookahead;
+  lookahead.events().push_back(door(3, start + 60s));
+
+  std::vector<std::string> requested;
+  const auto request = [&](const FacilityEvent& event)
+    {
+      requested.push_back(event.name);
+    };
+
+  WHEN("The robot is on schedule")
+  {
+    lookahead.update(0, 0s, start + 50s - 1ns, lead_time, request);
+    CHECK(requested.empty());
+
+    lookahead.update(0, 0s, start + 50s, lead_time, request);
+    CHECK(requested.size() == 1);
+
+    // The request is only ever sent once.
+    lookahead.update(0, 0s, start + 55s, lead_time, request);
+    CHECK(requested.size() == 1);
+  }
+
+  WHEN("The robot is running late")
+  {
+    lookahead.update(1, 5s, start + 55s - 1ns, lead_time, request);
+    CHECK(requested.empty());
+
+    lookahead.update(1, 5s, start + 55s, lead_time, request);
+    CHECK(requested.size() == 1);
+  }
+
+  WHEN("The robot has already reached the door")
+  {
+    lookahead.update(4, 0s, start + 70s, lead_time, request);
+    CHECK(requested.empty());
+    CHECK(lookahead.events().empty());
+  }
+}
+
+//==============================================================================
+SCENARIO("Requests that are not needed anymore get released")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time start = rmf_traffic::Time(1000s);
+
+  FacilityLookahead lookahead;
+  lookahead.events().push_back(door(1, start + 5s));
+  lookahead.events().push_back(door(2, start + 60s));
+
+  std::size_t requests = 0;
+  lookahead.update(
+    0, 0s, start, 10s, [&](const FacilityEvent&) { ++requests; });
+  CHECK(requests == 1);
+
+  std::size_t releases = 0;
+  lookahead.release_all([&](const FacilityEvent& event)
+    {
+      CHECK(event.plan_index == 1);
+      ++releases;
+    });
+  CHECK(releases == 1);
+  CHECK(lookahead.events().empty());
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "filtered_middleware.hpp"
+
+using free_fleet::messages::RobotState;
+using free_fleet::rmf::FilteredMiddleware;
+using free_fleet::rmf::StateFilter;
+
+namespace {
+
+//==============================================================================
+/// Hands out whatever states the test queued up
+class QueuedMiddleware : public free_fleet::transport::Middleware
+{
+public:
+
+  std::vector<RobotState> states;
+
+  void send_state(const RobotState& state) final
+  {
+    states.push_back(state);
+  }
+
+  std::vector<RobotState> read_states() final
+  {
+    return std::move(states);
+  }
+
+  void send_mode_request(const free_fleet::messages::ModeRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::ModeRequest>
+  read_mode_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_navigation_request(
+    const free_fleet::messages::NavigationRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::NavigationRequest>
+  read_navigation_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+
+  void send_relocalization_request(
+    const free_fleet::messages::RelocalizationRequest&) final {}
+
+  rmf_utils::optional<free_fleet::messages::RelocalizationRequest>
+  read_relocalization_request() final
+  {
+    return rmf_utils::nullopt;
+  }
+};
+
+//==============================================================================
+RobotState state(const std::string& name, const std::string& level, double x)
+{
+  RobotState state{};
+  state.name = name;
+  state.location.level_name = level;
+  state.location.x = x;
+  return state;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Filtered and superseded states are dropped and counted")
+{
+  const auto queue = std::make_shared<QueuedMiddleware>();
+  StateFilter filter;
+  filter.levels.insert("L1");
+  filter.history_depth = 1;
+  FilteredMiddleware middleware(queue, filter);
+
+  queue->send_state(state("a", "L1", 0.0));
+  queue->send_state(state("b", "L2", 0.0));
+  queue->send_state(state("c", "L1", 0.0));
+  queue->send_state(state("a", "L1", 1.0));
+  queue->send_state(state("a", "L1", 2.0));
+
+  const auto states = middleware.read_states();
+  REQUIRE(states.size() == 2);
+  CHECK(states[0].name == "c");
+  CHECK(states[1].name == "a");
+  CHECK(states[1].location.x == 2.0);
+  CHECK(middleware.discarded() == 1);
+  CHECK(middleware.superseded() == 2);
+
+  queue->send_state(state("b", "L2", 1.0));
+  CHECK(middleware.read_states().empty());
+  CHECK(middleware.discarded() == 2);
+  CHECK(middleware.superseded() == 2);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "fleet_snapshot.hpp"
+
+using free_fleet::rmf::FleetSnapshot;
+using free_fleet::rmf::FleetSnapshotPublisher;
+using free_fleet::rmf::RobotStateTable;
+
+namespace {
+
+//==============================================================================
+free_fleet::messages::RobotState state(
+  const std::string& name,
+  const std::string& level_name,
+  double x)
+{
+  free_fleet::messages::RobotState state{};
+  state.name = name;
+  state.location.level_name = level_name;
+  state.location.x = x;
+  return state;
+}
+
+//==============================================================================
+const FleetSnapshot::Level& level(
+  const FleetSnapshot& snapshot,
+  const std::string& name)
+{
+  for (const auto& level : snapshot.levels())
+  {
+    if (level->name == name)
+      return *level;
+  }
+
+  FAIL("Level [" << name << "] is not in the snapshot");
+  return *snapshot.levels().front();
+}
+
+//==============================================================================
+/// Feeds states through the table and the publisher the way ingestion does
+struct Fleet
+{
+  RobotStateTable table;
+  FleetSnapshotPublisher publisher;
+
+  void update(const free_fleet::messages::RobotState& state, int64_t now)
+  {
+    const auto slot = table.insert(state.name).first;
+    REQUIRE(table.update(slot, state, now));
+    publisher.update(slot, state);
+  }
+
+  void publish(int64_t now)
+  {
+    publisher.publish(table, now);
+  }
+};
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Snapshots share the robots and levels that did not change")
+{
+  Fleet fleet;
+  auto& publisher = fleet.publisher;
+  fleet.update(state("a", "L1", 0.0), 0);
+  fleet.update(state("b", "L2", 0.0), 0);
+  fleet.update(state("c", "L1", 0.0), 0);
+  fleet.publish(0);
+
+  const auto first = publisher.latest();
+  REQUIRE(first->size() == 3);
+  REQUIRE(first->levels().size() == 2);
+  CHECK(level(*first, "L1").robots.size() == 2);
+  CHECK(level(*first, "L1").robots[0]->name == "a");
+  CHECK(level(*first, "L1").robots[1]->name == "c");
+
+  WHEN("One robot moves within its level")
+  {
+    fleet.update(state("c", "L1", 1.0), 1);
+    fleet.publish(1);
+    const auto second = publisher.latest();
+
+    THEN("Only that robot and its level are new")
+    {
+      CHECK(second->version() == first->version() + 1);
+      CHECK(&level(*second, "L2") == &level(*first, "L2"));
+      CHECK(&level(*second, "L1") != &level(*first, "L1"));
+      CHECK(level(*second, "L1").robots[0] == level(*first, "L1").robots[0]);
+      CHECK(level(*second, "L1").robots[1]->x == 1.0);
+      CHECK(level(*first, "L1").robots[1]->x == 0.0);
+    }
+  }
+
+  WHEN("A robot changes level")
+  {
+    fleet.update(state("a", "L2", 0.0), 1);
+    fleet.publish(1);
+    const auto second = publisher.latest();
+
+    THEN("Both levels are rebuilt in slot order")
+    {
+      CHECK(second->size() == 3);
+      REQUIRE(level(*second, "L1").robots.size() == 1);
+      CHECK(level(*second, "L1").robots[0]->name == "c");
+      REQUIRE(level(*second, "L2").robots.size() == 2);
+      CHECK(level(*second, "L2").robots[0]->name == "a");
+      CHECK(level(*second, "L2").robots[1]->name == "b");
+    }
+  }
+
+  WHEN("The last robot leaves a level")
+  {
+    fleet.update(state("b", "L1", 0.0), 1);
+    fleet.publish(1);
+    const auto second = publisher.latest();
+    REQUIRE(second->levels().size() == 1);
+    CHECK(second->levels().front()->name == "L1");
+    CHECK(second->page("L2", 0, 0).total == 0);
+  }
+
+  WHEN("Nothing was updated")
+  {
+    fleet.publish(1);
+    CHECK(publisher.latest() == first);
+  }
+
+  WHEN("Pages are requested across levels")
+  {
+    const auto all = first->page("", 1, 2);
+    CHECK(all.total == 3);
+    REQUIRE(all.robots.size() == 2);
+    CHECK(all.robots[0]->name == "c");
+    CHECK(all.robots[1]->name == "b");
+
+    const auto l1 = first->page("L1", 1, 0);
+    CHECK(l1.total == 2);
+    REQUIRE(l1.robots.size() == 1);
+    CHECK(l1.robots[0]->name == "c");
+
+    CHECK(first->page("L1", 5, 0).robots.empty());
+  }
+}
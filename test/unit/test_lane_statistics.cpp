@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "lane_statistics.hpp"
+
+using free_fleet::rmf::LaneStatistics;
+
+//==============================================================================
+SCENARIO("The time of a run is spread over all of its lanes")
+{
+  LaneStatistics stats(0.2, 3, 0.5);
+
+  // A straight run of three lanes that simplification merged into one move
+  const std::vector<LaneStatistics::Traversal> run = {
+    {0, 1, 2.0},
+    {1, 2, 4.0},
+    {2, 3, 2.0}
+  };
+
+  for (int i = 0; i < 3; ++i)
+    stats.observe(run, 12.0);
+
+  for (const auto& lane : run)
+  {
+    const auto entry = stats.entry(lane.from_wp, lane.to_wp);
+    REQUIRE(entry);
+    CHECK(entry->count == 3);
+    CHECK(entry->mean == Approx(1.5));
+    CHECK(stats.ratio(lane.from_wp, lane.to_wp) == Approx(1.5));
+  }
+
+  CHECK(stats.ratio(run) == Approx(1.5));
+
+  // Only part of a longer run has been learned, so the estimate is weighed
+  // by how much of the run each lane makes up
+  const std::vector<LaneStatistics::Traversal> longer = {
+    {0, 1, 2.0},
+    {3, 4, 6.0}
+  };
+  CHECK(stats.ratio(longer) == Approx((2.0 * 1.5 + 6.0) / 8.0));
+}
+
+//==============================================================================
+SCENARIO("Lanes whose times vary too much are treated as nominal")
+{
+  LaneStatistics stats(0.2, 3, 0.5);
+
+  for (int i = 0; i < 10; ++i)
+    stats.observe(0, 1, 1.2 + (i % 2 == 0 ? 0.05 : -0.05));
+
+  CHECK(stats.ratio(0, 1) == Approx(1.2).margin(0.05));
+
+  for (int i = 0; i < 10; ++i)
+    stats.observe(2, 3, i % 2 == 0 ? 0.5 : 3.0);
+
+  const auto entry = stats.entry(2, 3);
+  REQUIRE(entry);
+  CHECK(entry->variance > 0.25);
+  CHECK(stats.ratio(2, 3) == 1.0);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "path_phase.hpp"
+
+using free_fleet::rmf::PathPhase;
+using free_fleet::rmf::PathInput;
+using free_fleet::rmf::PathTransitions;
+
+namespace {
+
+//==============================================================================
+/// The behaviour of the state machine as it was written before the table,
+/// spelled out input by input
+PathPhase expected(PathPhase phase, PathInput input)
+{
+  switch (input)
+  {
+    case PathInput::PathAccepted:
+      return PathPhase::Navigating;
+    case PathInput::DockRequested:
+      return PathPhase::Docking;
+    case PathInput::Stopped:
+    case PathInput::Abandoned:
+      return PathPhase::Idle;
+    case PathInput::RobotWaiting:
+      return phase == PathPhase::Navigating ? PathPhase::Waiting : phase;
+    case PathInput::RobotMoving:
+      return phase == PathPhase::Waiting ? PathPhase::Navigating : phase;
+    case PathInput::PathCompleted:
+      return phase == PathPhase::Navigating || phase == PathPhase::Waiting ?
+        PathPhase::Finished : phase;
+    case PathInput::DockCompleted:
+      return phase == PathPhase::Docking ? PathPhase::Finished : phase;
+    default:
+      return PathPhase::Count;
+  }
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Every transition of the path phase table is as specified")
+{
+  for (std::size_t p = 0; p < PathTransitions::NumPhases; ++p)
+  {
+    for (std::size_t i = 0; i < PathTransitions::NumInputs; ++i)
+    {
+      const auto phase = static_cast<PathPhase>(p);
+      const auto input = static_cast<PathInput>(i);
+      CAPTURE(p, i);
+      CHECK(PathTransitions::next(phase, input) == expected(phase, input));
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Robot modes map onto waiting or moving")
+{
+  using free_fleet::messages::RobotMode;
+
+  CHECK(PathTransitions::from_mode(RobotMode::MODE_WAITING)
+    == PathInput::RobotWaiting);
+  CHECK(PathTransitions::from_mode(RobotMode::MODE_PAUSED)
+    == PathInput::RobotWaiting);
+
+  for (const uint32_t mode :
+    {RobotMode::MODE_IDLE, RobotMode::MODE_CHARGING, RobotMode::MODE_MOVING,
+      RobotMode::MODE_EMERGENCY, RobotMode::MODE_GOING_HOME,
+      RobotMode::MODE_DOCKING, RobotMode::MODE_REQUEST_ERROR})
+  {
+    CAPTURE(mode);
+    CHECK(PathTransitions::from_mode(mode) == PathInput::RobotMoving);
+  }
+}
+
+//==============================================================================
+SCENARIO("Only phases with a command in progress are active")
+{
+  CHECK_FALSE(PathTransitions::is_active(PathPhase::Idle));
+  CHECK(PathTransitions::is_active(PathPhase::Navigating));
+  CHECK(PathTransitions::is_active(PathPhase::Waiting));
+  CHECK(PathTransitions::is_active(PathPhase::Docking));
+  CHECK_FALSE(PathTransitions::is_active(PathPhase::Finished));
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "path_simplifier.hpp"
+
+using free_fleet::rmf::PathSimplification;
+
+namespace {
+
+//==============================================================================
+/// Has what the simplifier reads from a plan waypoint
+struct TestWaypoint
+{
+  Eigen::Vector3d p;
+  rmf_traffic::Time t;
+  bool has_event = false;
+
+  Eigen::Vector3d position() const
+  {
+    return p;
+  }
+
+  rmf_traffic::Time time() const
+  {
+    return t;
+  }
+
+  const TestWaypoint* event() const
+  {
+    return has_event ? this : nullptr;
+  }
+};
+
+//==============================================================================
+TestWaypoint wp(double x, double y, double seconds, double yaw = 0.0)
+{
+  return TestWaypoint{
+    {x, y, yaw},
+    rmf_traffic::Time(rmf_traffic::time::from_seconds(seconds)),
+    false
+  };
+}
+
+//==============================================================================
+std::vector<std::size_t> kept(
+  const std::vector<TestWaypoint>& path,
+  const PathSimplification& params = PathSimplification())
+{
+  std::vector<std::size_t> indices;
+  free_fleet::rmf::simplify_path(
+    path.data(), path.size(), params,
+    [&](std::size_t i) { indices.push_back(i); });
+  return indices;
+}
+
+using Indices = std::vector<std::size_t>;
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Collinear waypoints at constant speed are merged")
+{
+  const std::vector<TestWaypoint> path = {
+    wp(0, 0, 0), wp(1, 0, 1), wp(2, 0.01, 2), wp(3, 0, 3), wp(4, 0, 4)
+  };
+  CHECK(kept(path) == Indices{0, 4});
+
+  PathSimplification disabled;
+  disabled.enabled = false;
+  CHECK(kept(path, disabled) == Indices{0, 1, 2, 3, 4});
+}
+
+//==============================================================================
+SCENARIO("Corners and turns are kept")
+{
+  // A waypoint off the line by more than the collinear tolerance
+  CHECK(kept({wp(0, 0, 0), wp(1, 0.2, 1), wp(2, 0, 2)}) == Indices{0, 1, 2});
+
+  // An L shaped path keeps its corner
+  CHECK(kept({wp(0, 0, 0), wp(1, 0, 1), wp(2, 0, 2), wp(2, 1, 3)})
+    == Indices{0, 2, 3});
+
+  // A waypoint behind the start of the line
+  CHECK(kept({wp(0, 0, 0), wp(-1, 0, 1), wp(2, 0, 2)}) == Indices{0, 1, 2});
+
+  // The robot turns in place at the middle waypoint
+  CHECK(kept({wp(0, 0, 0), wp(1, 0, 1, 0.0), wp(2, 0, 2, 0.5)})
+    == Indices{0, 1, 2});
+}
+
+//==============================================================================
+SCENARIO("Waits and speed changes are kept by the timing tolerance")
+{
+  // The robot waits for 5 s at x = 1
+  CHECK(kept({wp(0, 0, 0), wp(1, 0, 1), wp(1, 0, 6), wp(2, 0, 7)})
+    == Indices{0, 1, 2, 3});
+
+  // The robot slows down to a quarter of its speed after x = 1
+  CHECK(kept({wp(0, 0, 0), wp(1, 0, 1), wp(2, 0, 5), wp(3, 0, 9)})
+    == Indices{0, 1, 3});
+
+  // Small timing differences are within the tolerance
+  CHECK(kept({wp(0, 0, 0), wp(1, 0, 1.2), wp(2, 0, 2)}) == Indices{0, 2});
+}
+
+//==============================================================================
+SCENARIO("Waypoints with lane events are never dropped")
+{
+  std::vector<TestWaypoint> path = {
+    wp(0, 0, 0), wp(1, 0, 1), wp(2, 0, 2), wp(3, 0, 3)
+  };
+  path[2].has_event = true;
+  CHECK(kept(path) == Indices{0, 2, 3});
+}
+
+//==============================================================================
+SCENARIO("The first and last waypoints are always kept")
+{
+  CHECK(kept({}).empty());
+  CHECK(kept({wp(0, 0, 0)}) == Indices{0});
+  CHECK(kept({wp(0, 0, 0), wp(0, 0, 0)}) == Indices{0, 1});
+
+  std::vector<TestWaypoint> path = {wp(0, 0, 0), wp(1, 0, 1), wp(2, 0, 2)};
+  path.front().has_event = true;
+  path.back().has_event = true;
+  CHECK(kept(path) == Indices{0, 2});
+}
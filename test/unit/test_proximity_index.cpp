@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <rmf_utils/catch.hpp>
+
+#include "proximity_index.hpp"
+
+using free_fleet::rmf::ProximityIndex;
+using free_fleet::rmf::RobotStateTable;
+
+namespace {
+
+//==============================================================================
+RobotStateTable::Index place(
+  RobotStateTable& table,
+  ProximityIndex& index,
+  const std::string& name,
+  const std::string& level_name,
+  double x,
+  double y)
+{
+  free_fleet::messages::RobotState state{};
+  state.name = name;
+  state.location.level_name = level_name;
+  state.location.x = x;
+  state.location.y = y;
+  const auto slot = table.insert(name).first;
+  REQUIRE(table.update(slot, state, 1));
+  index.update(table, slot);
+  return slot;
+}
+
+//==============================================================================
+std::vector<RobotStateTable::Index> sorted(
+  std::vector<RobotStateTable::Index> slots)
+{
+  std::sort(slots.begin(), slots.end());
+  return slots;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Robots are found within a radius on their own level")
+{
+  RobotStateTable table;
+  ProximityIndex index(2.0);
+  const auto a = place(table, index, "a", "L1", 0.0, 0.0);
+  const auto b = place(table, index, "b", "L1", 3.0, 0.0);
+  const auto c = place(table, index, "c", "L1", 10.0, 10.0);
+  place(table, index, "d", "L2", 0.5, 0.5);
+  const uint16_t l1 = table.level[a];
+
+  std::vector<RobotStateTable::Index> found;
+  index.query(table, l1, 0.0, 0.0, 4.0, found);
+  CHECK(sorted(found) == sorted({a, b}));
+
+  index.neighbors(table, a, 4.0, found);
+  CHECK(found == std::vector<RobotStateTable::Index>{b});
+
+  WHEN("The radius spans more cells than there are robots")
+  {
+    index.query(table, l1, 0.0, 0.0, 1e6, found);
+    CHECK(sorted(found) == sorted({a, b, c}));
+
+    index.query(table, l1, 0.0, 0.0, std::numeric_limits<double>::max(),
+      found);
+    CHECK(sorted(found) == sorted({a, b, c}));
+  }
+
+  WHEN("A robot moves into another cell")
+  {
+    place(table, index, "c", "L1", 1.0, 1.0);
+    index.query(table, l1, 0.0, 0.0, 4.0, found);
+    CHECK(sorted(found) == sorted({a, b, c}));
+  }
+
+  WHEN("The inputs are not finite")
+  {
+    const double nan = std::nan("");
+    const double inf = std::numeric_limits<double>::infinity();
+    index.query(table, l1, nan, 0.0, 4.0, found);
+    CHECK(found.empty());
+    index.query(table, l1, 0.0, inf, 4.0, found);
+    CHECK(found.empty());
+    index.query(table, l1, 0.0, 0.0, inf, found);
+    CHECK(found.empty());
+    index.query(table, l1, 0.0, 0.0, nan, found);
+    CHECK(found.empty());
+  }
+
+  WHEN("A robot reports a position that is not finite")
+  {
+    place(table, index, "b", "L1", std::nan(""), 0.0);
+    index.query(table, l1, 0.0, 0.0, 1e6, found);
+    CHECK(sorted(found) == sorted({a, c}));
+  }
+}
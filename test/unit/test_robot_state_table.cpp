@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "robot_state_table.hpp"
+
+using free_fleet::rmf::RobotStateTable;
+
+//==============================================================================
+SCENARIO("Level ids never wrap around or collide with NoLevel")
+{
+  RobotStateTable table;
+  bool sequential = true;
+  for (std::size_t i = 0; i < RobotStateTable::MaxLevels; ++i)
+    sequential &= table.level_id("L" + std::to_string(i)) == i;
+
+  CHECK(sequential);
+
+  CHECK(table.level_id("one_too_many") == RobotStateTable::NoLevel);
+  CHECK(table.level_id("L0") == 0);
+  CHECK(table.level_name(RobotStateTable::NoLevel).empty());
+
+  free_fleet::messages::RobotState state{};
+  state.name = "robot";
+  state.location.level_name = "one_too_many";
+  state.location.x = 5.0;
+  const auto slot = table.insert(state.name).first;
+  CHECK_FALSE(table.update(slot, state, 1));
+  CHECK(table.level[slot] == RobotStateTable::NoLevel);
+  CHECK(table.x[slot] == 0.0);
+  CHECK(table.last_seen[slot] == 0);
+
+  state.location.level_name = "L7";
+  CHECK(table.update(slot, state, 1));
+  CHECK(table.level_name(table.level[slot]) == "L7");
+  CHECK(table.x[slot] == 5.0);
+}
+
+//==============================================================================
+SCENARIO("The memory of the table covers more than its hot arrays")
+{
+  RobotStateTable table;
+  const std::size_t robots = 1000;
+  for (std::size_t i = 0; i < robots; ++i)
+    table.insert("a_robot_name_that_does_not_fit_inline_" + std::to_string(i));
+
+  CHECK(table.memory_bytes()
+    > robots * (RobotStateTable::bytes_per_robot() + 40));
+}
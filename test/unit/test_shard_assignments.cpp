@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "shard_assignments.hpp"
+
+using free_fleet::rmf::ShardAssignments;
+
+namespace {
+
+//==============================================================================
+std::vector<std::string> robot_names(const std::string& prefix, std::size_t n)
+{
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < n; ++i)
+    names.push_back(prefix + std::to_string(i));
+
+  return names;
+}
+
+//==============================================================================
+/// Deliver the claims of one shard to the other, as the claims topic would
+void announce(const ShardAssignments& from, ShardAssignments& to)
+{
+  CHECK(to.set_claims(from.shard_id(), from.claims()).empty());
+}
+
+//==============================================================================
+/// Every robot must be owned by exactly one of the shards, and both shards
+/// must agree on which one
+void check_agreement(
+  ShardAssignments& a,
+  ShardAssignments& b,
+  const std::vector<std::string>& robots,
+  rmf_traffic::Time now)
+{
+  for (const auto& robot : robots)
+  {
+    const auto owner_a = a.owner(robot, now);
+    const auto owner_b = b.owner(robot, now);
+    REQUIRE(owner_a);
+    REQUIRE(owner_b);
+    CHECK(*owner_a == *owner_b);
+  }
+
+  announce(a, b);
+  announce(b, a);
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("A shard does not assign robots before it has settled")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time start = rmf_traffic::Time(1000s);
+  ShardAssignments b(1, 5s, start);
+
+  // No peers have been discovered yet, which used to make the new shard
+  // claim every robot right away
+  CHECK_FALSE(b.owner("robot", start));
+  CHECK_FALSE(b.owner("robot", start + 1s));
+  CHECK(b.claims().empty());
+
+  WHEN("No peer shows up within the settle time")
+  {
+    const auto owner = b.owner("robot", start + 5s);
+    REQUIRE(owner);
+    CHECK(*owner == 1);
+    CHECK(b.claims().size() == 1);
+  }
+
+  WHEN("A peer shows up but has not announced its claims")
+  {
+    CHECK(b.set_members({0, 1}, start + 1s));
+    CHECK_FALSE(b.owner("robot", start + 6s));
+    CHECK_FALSE(b.settled(start + 60s));
+
+    b.set_claims(0, {});
+    CHECK(b.settled(start + 6s));
+    CHECK(b.owner("robot", start + 6s));
+  }
+}
+
+//==============================================================================
+SCENARIO("Shards agree on owners while one of them joins")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time start = rmf_traffic::Time(1000s);
+  const auto early = robot_names("early_", 50);
+  const auto late = robot_names("late_", 50);
+
+  // Shard 0 has been running alone and owns every robot it has seen
+  ShardAssignments a(0, 5s, start - 60s);
+  for (const auto& robot : early)
+    CHECK(*a.owner(robot, start) == 0);
+
+  const rmf_traffic::Time joined = start + 10s;
+  ShardAssignments b(1, 5s, joined);
+  announce(b, a);
+
+  WHEN("The running shard discovers the new one first")
+  {
+    CHECK(a.set_members({0, 1}, joined));
+    announce(a, b);
+    CHECK(b.set_members({0, 1}, joined + 1s));
+
+    // The running shard keeps its robots, but new robots wait for both
+    // shards to settle instead of being computed over different rings
+    for (const auto& robot : early)
+      CHECK(*a.owner(robot, joined + 2s) == 0);
+
+    for (const auto& robot : late)
+    {
+      CHECK_FALSE(a.owner(robot, joined + 2s));
+      CHECK_FALSE(b.owner(robot, joined + 2s));
+    }
+
+    THEN("Both shards agree once settled")
+    {
+      check_agreement(a, b, early, joined + 6s);
+      check_agreement(a, b, late, joined + 6s);
+      CHECK(a.claims().size() + b.claims().size() == 100);
+      CHECK(a.claims().size() >= early.size());
+    }
+  }
+
+  WHEN("The new shard discovers the running one first")
+  {
+    CHECK(b.set_members({0, 1}, joined));
+    announce(a, b);
+
+    // The running shard has not seen the new one yet, so it keeps assigning
+    // robots to itself over its own ring
+    for (const auto& robot : late)
+      CHECK(*a.owner(robot, joined + 1s) == 0);
+
+    announce(a, b);
+    CHECK(a.set_members({0, 1}, joined + 2s));
+
+    // Robots that the running shard claimed before it noticed the new one
+    // stay with it on both sides
+    for (const auto& robot : late)
+      CHECK(*b.owner(robot, joined + 5s) == 0);
+
+    THEN("Both shards agree once settled")
+    {
+      check_agreement(a, b, early, joined + 7s);
+      check_agreement(a, b, late, joined + 7s);
+      CHECK(b.claims().empty());
+
+      const auto fresh = robot_names("fresh_", 50);
+      check_agreement(a, b, fresh, joined + 7s);
+      CHECK(!b.claims().empty());
+      CHECK(a.claims().size() + b.claims().size() == 150);
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Robots of a shard that leaves are taken over")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time start = rmf_traffic::Time(1000s);
+  const auto robots = robot_names("robot_", 50);
+
+  ShardAssignments a(0, 5s, start);
+  ShardAssignments b(1, 5s, start);
+  a.set_members({0, 1}, start);
+  b.set_members({0, 1}, start);
+  announce(a, b);
+  announce(b, a);
+  check_agreement(a, b, robots, start + 5s);
+  REQUIRE(!b.claims().empty());
+
+  CHECK(a.set_members({0}, start + 10s));
+  for (const auto& robot : b.claims())
+    CHECK_FALSE(a.owner(robot, start + 11s));
+
+  for (const auto& robot : robots)
+    CHECK(*a.owner(robot, start + 15s) == 0);
+}
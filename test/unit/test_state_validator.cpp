@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <limits>
+
+#include <rmf_utils/catch.hpp>
+
+#include "state_validator.hpp"
+
+using free_fleet::messages::RobotState;
+using free_fleet::rmf::StateValidator;
+
+namespace {
+
+//==============================================================================
+RobotState state(
+  const std::string& level,
+  double x,
+  double y,
+  double yaw = 0.0)
+{
+  RobotState state{};
+  state.name = "robot";
+  state.location.level_name = level;
+  state.location.x = x;
+  state.location.y = y;
+  state.location.yaw = yaw;
+  return state;
+}
+
+//==============================================================================
+std::vector<uint8_t> validate(
+  StateValidator& validator,
+  const std::vector<RobotState>& states)
+{
+  std::vector<uint8_t> accepted;
+  validator.validate(states, accepted);
+  return accepted;
+}
+
+using Accepted = std::vector<uint8_t>;
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("States must lie within the waypoints of their level plus a margin")
+{
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint("L1", {0.0, 0.0});
+  graph.add_waypoint("L1", {10.0, 5.0});
+  graph.add_waypoint("L2", {100.0, 100.0});
+
+  StateValidator validator(graph, 1.0);
+
+  CHECK(validate(validator, {
+    state("L1", 5.0, 2.5),
+    state("L1", -1.0, -1.0),
+    state("L1", 11.0, 6.0),
+    state("L1", -1.1, 0.0),
+    state("L1", 0.0, 6.1),
+    state("L2", 100.5, 99.5),
+    state("L2", 5.0, 2.5)
+  }) == Accepted{1, 1, 1, 0, 0, 1, 0});
+
+  CHECK(validator.quarantined() == 3);
+}
+
+//==============================================================================
+SCENARIO("Poses that are not finite or on unknown levels are rejected")
+{
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint("L1", {0.0, 0.0});
+  graph.add_waypoint("L1", {10.0, 10.0});
+
+  StateValidator validator(graph, 0.0);
+
+  const double nan = std::nan("");
+  const double inf = std::numeric_limits<double>::infinity();
+  CHECK(validate(validator, {
+    state("L1", nan, 1.0),
+    state("L1", 1.0, nan),
+    state("L1", inf, 1.0),
+    state("L1", 1.0, -inf),
+    state("L1", 1.0, 1.0, nan),
+    state("L1", 1.0, 1.0, inf),
+    state("L1", 1.0, 1.0, -inf),
+    state("unknown", 1.0, 1.0),
+    state("", 1.0, 1.0),
+    state("L1", 1.0, 1.0, 3.0)
+  }) == Accepted{0, 0, 0, 0, 0, 0, 0, 0, 0, 1});
+
+  CHECK(validator.quarantined() == 9);
+  CHECK(validate(validator, {}).empty());
+  CHECK(validator.quarantined() == 9);
+}
+
+//==============================================================================
+SCENARIO("Rejections are counted for each slot")
+{
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint("L1", {0.0, 0.0});
+  StateValidator validator(graph, 1.0);
+
+  validator.record(0, true);
+  validator.record(0, false);
+  validator.record(0, true);
+  validator.record(0, true);
+  const auto& record = validator.record(3, false);
+  CHECK(record.accepted == 0);
+  CHECK(record.rejected == 1);
+  CHECK(record.rejection_rate() == 1.0);
+
+  const auto& first = validator.record(0, false);
+  CHECK(first.accepted == 3);
+  CHECK(first.rejected == 2);
+  CHECK(first.rejection_rate() == Approx(0.4));
+
+  CHECK(StateValidator::Record().rejection_rate() == 0.0);
+}
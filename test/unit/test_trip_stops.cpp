@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_utils/catch.hpp>
+
+#include "trip_stops.hpp"
+
+using free_fleet::rmf::TripStopCounter;
+using free_fleet::rmf::TripStops;
+
+//==============================================================================
+SCENARIO("Stops on the way count, the stop at the destination does not")
+{
+  TripStopCounter counter;
+  auto time = TripStopCounter::Clock::now();
+  double x = 0.0;
+  const auto report = [&](double speed)
+    {
+      time += std::chrono::milliseconds(100);
+      x += speed * 0.1;
+      counter.observe(x, 0.0, time);
+    };
+
+  // Positions outside of a trip are ignored
+  report(1.0);
+  report(0.0);
+  CHECK(counter.end_trip() == 0);
+  CHECK(counter.totals().trips == 0);
+
+  counter.begin_trip();
+  report(0.0);
+  report(0.0);
+  report(0.5);
+  report(0.5);
+  report(0.0);
+  report(0.0);
+  report(0.5);
+  report(0.0);
+  CHECK(counter.end_trip() == 1);
+
+  // A burst of states without time in between says nothing about the speed
+  counter.begin_trip();
+  report(0.5);
+  report(0.5);
+  counter.observe(x, 0.0, time);
+  report(0.5);
+  CHECK(counter.end_trip() == 0);
+
+  const TripStops& totals = counter.totals();
+  CHECK(totals.trips == 2);
+  CHECK(totals.stops == 1);
+  CHECK(totals.max_stops == 1);
+  CHECK(totals.stops_per_trip() == Approx(0.5));
+
+  TripStops fleet;
+  fleet += totals;
+  fleet += TripStops{1, 4, 4};
+  CHECK(fleet.trips == 3);
+  CHECK(fleet.stops == 5);
+  CHECK(fleet.max_stops == 4);
+}